@@ -0,0 +1,69 @@
+#!/usr/bin/env python
+
+"""
+Stand-in for the arducopter stepper board, for testing the gazebo_serial_hil
+plugin without hardware. Connects to the pty opened by the plugin (device set
+to "pty", the name is printed by gazebo and set as serial_hil_device), reads
+the mass command frames and answers every one of them with a readback frame
+of the stepper positions. The steppers move to the commanded position with
+a limited speed, like the real board.
+
+Usage:
+    stepper_board_standin.py /dev/pts/3 --speed 5000
+"""
+
+__author__ = 'mmuav'
+
+import argparse
+import os
+import struct
+import termios
+import time
+import tty
+
+FRAME = struct.Struct('<4iB3x')
+MASS_COMMAND = 67
+PARAMETERS = 83
+MASS_READBACK = 80
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Stepper board stand-in for hardware in the loop tests.')
+    parser.add_argument('device')
+    parser.add_argument('--speed', type=float, default=5000.0, help='stepper speed [steps/s]')
+    args = parser.parse_args()
+
+    fd = os.open(args.device, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd, termios.TCSANOW)
+
+    position = [0.0] * 4
+    target = [0] * 4
+    last = time.time()
+    data = b''
+    while True:
+        data += os.read(fd, 256)
+        while len(data) >= FRAME.size:
+            values = FRAME.unpack(data[:FRAME.size])
+            terminator = values[4]
+            if data[FRAME.size - 3:FRAME.size] != b'\0\0\0' or terminator not in (MASS_COMMAND, PARAMETERS):
+                # Out of sync, drop one byte.
+                data = data[1:]
+                continue
+            data = data[FRAME.size:]
+
+            if terminator == PARAMETERS:
+                args.speed = float(values[1]) or args.speed
+                print('Parameters: gain %d, speed %d, acceleration %d, deadzone %d' % values[:4])
+                continue
+
+            target = list(values[:4])
+            now = time.time()
+            step = args.speed * (now - last)
+            last = now
+            for i in range(4):
+                position[i] += max(-step, min(target[i] - position[i], step))
+            os.write(fd, FRAME.pack(*([int(round(p)) for p in position] + [MASS_READBACK])))
+
+
+if __name__ == '__main__':
+    main()
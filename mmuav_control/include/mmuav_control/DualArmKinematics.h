@@ -0,0 +1,96 @@
+/******************************************************************************
+File name: DualArmKinematics.h
+Description: Kinematics of the two 2R arms joined by a passive joint at the
+    end effector.
+******************************************************************************/
+
+#ifndef MMUAV_CONTROL_DUAL_ARM_KINEMATICS_H
+#define MMUAV_CONTROL_DUAL_ARM_KINEMATICS_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+typedef std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > GoalVector;
+typedef std::vector<Eigen::Vector3d> JointVector;
+
+struct DualArmGeometry
+{
+    double l1;          // first link
+    double l2;          // second link
+    double l3;          // passive joint to the common end effector
+    // Passive joint angles searched for the closest solution [rad].
+    double phiMin;
+    double phiMax;
+    double phiStep;
+};
+
+/*
+Vectorized C++ version of DualManipulatorPassiveJointKinematics.py.
+
+Each arm is a planar 2R manipulator with a standard DH table |theta d alpha a|.
+Both arms hold a common end effector through passive joints. For a goal of
+the end effector the passive joint angle phi is scanned and for every phi both
+arms are solved in closed form. The pair of solutions closest to the current
+joints is returned.
+
+A reachability grid over the goal plane rejects goals before any IK is
+solved. A grid cell is marked reachable if, for some phi, the goals of both
+arms at the cell center are within the arm annulus [|l1 - l2|, l1 + l2]
+widened by the half diagonal of the cell. Every goal in an unmarked cell is
+therefore certainly unreachable, while goals in marked cells are still
+checked by the IK itself.
+*/
+class DualArmKinematics
+{
+public:
+    explicit DualArmKinematics(const DualArmGeometry &geometry);
+
+    static Eigen::Matrix4d dhTransform(double theta, double d, double alpha, double a);
+
+    // Tool frame of one arm.
+    Eigen::Matrix4d forwardKinematics(double q1, double q2) const;
+
+    // Both elbow solutions, one per column [q1 q2 q3], q3 keeps the tool
+    // orientation. Returns false if the goal is out of reach.
+    bool inverseKinematics2R(const Eigen::Vector2d &goal, Eigen::Matrix<double, 3, 2> &q) const;
+
+    // Solution closest to qStart, angle differences are wrapped to [-pi, pi].
+    bool closestInverseKinematics2R(const Eigen::Vector3d &qStart, const Eigen::Vector2d &goal,
+        Eigen::Vector3d &q) const;
+
+    // Joints of both arms that put the end effector to goal, as ik_both_arms.
+    bool solve(const Eigen::Vector3d &qA, const Eigen::Vector3d &qB, const Eigen::Vector2d &goal,
+        Eigen::Vector3d &solutionA, Eigen::Vector3d &solutionB) const;
+
+    // Goal to the first arm and to the second arm for a passive joint angle.
+    void armGoals(const Eigen::Vector2d &goal, double phi, Eigen::Vector2d &goalA,
+        Eigen::Vector2d &goalB) const;
+
+    void buildReachabilityGrid(double resolution);
+    // False only for goals that can not be reached. Always true without a grid.
+    bool maybeReachable(const Eigen::Vector2d &goal) const;
+
+    // Solves all goals, split over threads. Unreachable goals get zero
+    // joints. With checkOnly only the reachability grid is evaluated.
+    void solveBatch(const GoalVector &goals, const Eigen::Vector3d &qA, const Eigen::Vector3d &qB,
+        bool checkOnly, int threads, std::vector<uint8_t> &reachable,
+        JointVector &solutionsA, JointVector &solutionsB) const;
+
+private:
+    void solveRange(const GoalVector &goals, const Eigen::Vector3d &qA, const Eigen::Vector3d &qB,
+        bool checkOnly, size_t begin, size_t end, std::vector<uint8_t> &reachable,
+        JointVector &solutionsA, JointVector &solutionsB) const;
+
+    DualArmGeometry geometry_;
+    std::vector<double> phis_;
+
+    double gridResolution_;
+    Eigen::Vector2d gridOrigin_;
+    int gridWidth_, gridHeight_;
+    std::vector<uint8_t> grid_;
+};
+
+#endif // MMUAV_CONTROL_DUAL_ARM_KINEMATICS_H
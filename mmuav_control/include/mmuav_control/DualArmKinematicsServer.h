@@ -0,0 +1,33 @@
+/******************************************************************************
+File name: DualArmKinematicsServer.h
+Description: ROS service for batched dual arm inverse kinematics.
+******************************************************************************/
+
+#ifndef MMUAV_CONTROL_DUAL_ARM_KINEMATICS_SERVER_H
+#define MMUAV_CONTROL_DUAL_ARM_KINEMATICS_SERVER_H
+
+#include <memory>
+
+#include <ros/ros.h>
+#include <mmuav_msgs/DualArmInverseKinematics.h>
+
+#include <mmuav_control/DualArmKinematics.h>
+
+class DualArmKinematicsServer
+{
+public:
+    DualArmKinematicsServer();
+    void run();
+
+private:
+    bool inverseKinematicsCallback(mmuav_msgs::DualArmInverseKinematics::Request &req,
+        mmuav_msgs::DualArmInverseKinematics::Response &res);
+
+    ros::NodeHandle nhParams, nhTopics;
+    ros::ServiceServer inverseKinematicsService;
+
+    int threads;
+    std::unique_ptr<DualArmKinematics> kinematics;
+};
+
+#endif // MMUAV_CONTROL_DUAL_ARM_KINEMATICS_SERVER_H
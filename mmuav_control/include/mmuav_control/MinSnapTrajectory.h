@@ -0,0 +1,117 @@
+/******************************************************************************
+File name: MinSnapTrajectory.h
+Description: Minimum snap polynomial trajectory generation through keyframes.
+******************************************************************************/
+
+#ifndef MMUAV_CONTROL_MIN_SNAP_TRAJECTORY_H
+#define MMUAV_CONTROL_MIN_SNAP_TRAJECTORY_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+// One row per keyframe or sample, columns are x, y, z and yaw.
+typedef Eigen::Matrix<double, Eigen::Dynamic, 4> TrajectoryMatrix;
+
+/*
+Piecewise polynomial in x, y, z and yaw. Segment k is
+    p(t) = sum_i coefficients[k](i, :) * t^i,  t in [0, durations[k]]
+*/
+class PolynomialTrajectory
+{
+public:
+    std::vector<double> durations;
+    std::vector<TrajectoryMatrix> coefficients;
+
+    double duration() const;
+    int segmentCount() const { return durations.size(); }
+
+    // Value and derivatives 0..derivativeCount-1 at the start of a segment,
+    // one row per derivative. segment == segmentCount() gives the final knot.
+    TrajectoryMatrix knotDerivatives(int segment, int derivativeCount) const;
+
+    // Samples the whole trajectory every dt seconds (and at its end). Each
+    // segment is evaluated at once as a Vandermonde matrix times coefficient
+    // product, instead of evaluating the polynomials point by point.
+    void sample(double dt, std::vector<double> &times, TrajectoryMatrix &position,
+        TrajectoryMatrix &velocity, TrajectoryMatrix &acceleration) const;
+};
+
+/*
+Minimum snap trajectory generator (unconstrained QP formulation).
+
+The decision variables are the derivatives 0..D-1 of every knot, D being
+(polynomialOrder + 1) / 2. Positions of all knots and all derivatives of the
+first and the last knot are fixed, the remaining derivatives are free. The
+cost of the free derivatives is
+    J = [dF; dP]^T R [dF; dP],  R = M^T A^-T Q A^-1 M
+and the optimum is dP = -R_PP^-1 R_PF dF. R depends only on the segment
+durations, never on the keyframes, so its sparse (block tridiagonal)
+factorization is cached with the durations as key. Planning a new set of
+keyframes with a known segment structure only costs two sparse triangular
+solves.
+
+Yaw uses its own (lower) cost derivative and its own cache entries.
+*/
+class MinSnapTrajectoryGenerator
+{
+public:
+    MinSnapTrajectoryGenerator(int polynomialOrder = 9, int positionDerivative = 4,
+        int yawDerivative = 2, size_t cacheCapacity = 64);
+
+    // Plans through keyframes (rows), times are segment durations. The
+    // trajectory starts and ends at rest.
+    bool generate(const TrajectoryMatrix &keyframes, const std::vector<double> &durations,
+        PolynomialTrajectory &trajectory);
+
+    // Keeps segments 0..firstSegment-1 of current and replans the rest
+    // through keyframes. The first keyframe row stands for knot firstSegment
+    // and is replaced by the full state of current at that knot, so the new
+    // tail joins the kept segments with continuous derivatives.
+    bool replanTail(const PolynomialTrajectory &current, int firstSegment,
+        const TrajectoryMatrix &keyframes, const std::vector<double> &durations,
+        PolynomialTrajectory &trajectory);
+
+    // Segment durations from the distance between keyframes.
+    static std::vector<double> estimateDurations(const TrajectoryMatrix &keyframes,
+        double maxVelocity, double maxYawRate, double minDuration);
+
+    int derivativeCount() const { return derivativeCount_; }
+    size_t cacheSize();
+
+private:
+    struct Structure
+    {
+        std::vector<int> variableIndex;     // knot derivative -> row in fixed or free vector
+        std::vector<bool> variableFree;
+        int freeCount;
+        int fixedCount;
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > freeSolver;   // R_PP
+        Eigen::SparseMatrix<double> freeFixed;                            // R_PF
+        std::vector<Eigen::MatrixXd> inverseA;
+    };
+    typedef std::pair<int, std::vector<double> > StructureKey;
+
+    bool plan(const TrajectoryMatrix &keyframes, const std::vector<double> &durations,
+        const TrajectoryMatrix &startDerivatives, PolynomialTrajectory &trajectory);
+    std::shared_ptr<const Structure> getStructure(const std::vector<double> &durations, int costDerivative);
+    std::shared_ptr<Structure> buildStructure(const std::vector<double> &durations, int costDerivative) const;
+    bool solve(const Structure &structure, const Eigen::MatrixXd &fixedValues, Eigen::MatrixXd &knots) const;
+
+    int polynomialOrder_;
+    int derivativeCount_;
+    int positionDerivative_;
+    int yawDerivative_;
+    size_t cacheCapacity_;
+
+    std::mutex cacheMutex_;
+    std::map<StructureKey, std::shared_ptr<const Structure> > cache_;
+    std::deque<StructureKey> cacheOrder_;
+};
+
+#endif // MMUAV_CONTROL_MIN_SNAP_TRAJECTORY_H
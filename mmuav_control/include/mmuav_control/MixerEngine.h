@@ -0,0 +1,85 @@
+/******************************************************************************
+File name: MixerEngine.h
+Description: Maps controller outputs to motor velocities with a precomputed
+    allocation matrix.
+******************************************************************************/
+
+#ifndef MMUAV_CONTROL_MIXER_ENGINE_H
+#define MMUAV_CONTROL_MIXER_ENGINE_H
+
+#include <istream>
+#include <string>
+
+#include <Eigen/Dense>
+
+/*
+Inputs are laid out as the Pixhawk actuator control groups, input
+8 * group + index. Group 0 is the one filled from the controllers:
+    0 roll, 1 pitch, 2 yaw, 3 thrust (mot_vel_ref), 4 vpc roll, 5 vpc pitch
+
+Two mixer file formats are understood, lines starting with anything else are
+comments:
+
+Pixhawk summing mixers, scalers given in units of 1/10000,
+    M: <control count>
+    O: <negative scale> <positive scale> <offset> <lower limit> <upper limit>
+    S: <group> <index> <negative scale> <positive scale> <offset> <lower> <upper>
+    Z:                      (output that is always zero)
+
+Plain matrix rows, one output per row, optionally followed by its limits,
+    W: <coefficient of input 0> ... <coefficient of input n-1>
+    L: <lower limit> <upper limit>
+Every W: row of a file has the same number of coefficients. Pixhawk
+multirotor mixers (R: <geometry> ...) are rejected, not read as rows.
+
+Every scaler is linear on each side of zero, so splitting the inputs into
+their positive and negative parts, v = [max(u, 0); min(u, 0)], turns the
+whole mixer into
+    y = clamp(scale(A v + b), lower, upper)
+A is built once on load and every call is one fixed-size matrix-vector
+product followed by the elementwise output scalers. The limits of the
+single S: terms are not applied, load() reports when they could matter for
+inputs in [-1, 1].
+*/
+class MixerEngine
+{
+public:
+    static const int kMaxInputs = 16;
+    static const int kMaxOutputs = 16;
+
+    // Unused inputs must be zero, outputs past outputCount() are zero.
+    typedef Eigen::Matrix<double, kMaxInputs, 1> InputVector;
+    typedef Eigen::Matrix<double, kMaxOutputs, 1> OutputVector;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    MixerEngine();
+
+    // Returns false and an explanation in error if the file can not be used.
+    // warning is set if some term limits of a Pixhawk mixer are ignored.
+    bool load(const std::string &fileName, std::string &error, std::string &warning);
+    bool parse(std::istream &in, std::string &error, std::string &warning);
+
+    void mix(const InputVector &input, OutputVector &output) const;
+    // A single output, for users that only need their own motor.
+    double mix(const InputVector &input, int output) const;
+
+    int inputCount() const { return inputCount_; }
+    int outputCount() const { return outputCount_; }
+
+private:
+    typedef Eigen::Matrix<double, 2 * kMaxInputs, 1> SplitVector;
+
+    void clear();
+    SplitVector split(const InputVector &input) const;
+
+    int inputCount_;
+    int outputCount_;
+    // Columns 0..kMaxInputs-1 act on the positive, the rest on the negative part.
+    Eigen::Matrix<double, kMaxOutputs, 2 * kMaxInputs> allocation_;
+    OutputVector offset_;
+    OutputVector negativeScale_, positiveScale_, outputOffset_;
+    OutputVector lower_, upper_;
+};
+
+#endif // MMUAV_CONTROL_MIXER_ENGINE_H
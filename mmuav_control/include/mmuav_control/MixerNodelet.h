@@ -0,0 +1,68 @@
+/******************************************************************************
+File name: MixerNodelet.h
+Description: Nodelet mapping controller outputs to motor velocities.
+******************************************************************************/
+
+#ifndef MMUAV_CONTROL_MIXER_NODELET_H
+#define MMUAV_CONTROL_MIXER_NODELET_H
+
+#include <mutex>
+#include <vector>
+
+#include <nodelet/nodelet.h>
+#include <ros/ros.h>
+#include <geometry_msgs/Vector3Stamped.h>
+#include <mav_msgs/Actuators.h>
+#include <std_msgs/Float64.h>
+#include <std_msgs/Float64MultiArray.h>
+
+#include <mmuav_control/MixerEngine.h>
+
+namespace mmuav_control
+{
+
+/*
+Replaces the *controller_outputs_to_motor_velocities.py nodes. Subscribes to
+mot_vel_ref and attitude_command and publishes command/motors as soon as a
+new controller output arrives, once both have been received. Loaded into the
+same manager as the controllers, the messages are passed without
+serialization.
+
+Parameters:
+    ~mixer_file                 mixer, see MixerEngine.h
+    ~controller                 attitude controller publishing
+                                attitude_command, sets the defaults of the
+                                two parameters below: vpc (default, all
+                                vpc_* controllers), mmuav,
+                                rotors_variation or vector3
+    ~vector3_attitude_command   attitude_command is a Vector3Stamped
+    ~attitude_command_inputs    mixer input of every attitude_command
+                                element, -1 to ignore it
+*/
+class MixerNodelet : public nodelet::Nodelet
+{
+public:
+    MixerNodelet();
+
+private:
+    virtual void onInit();
+
+    void thrustCallback(const std_msgs::Float64ConstPtr &msg);
+    void attitudeCallback(const std_msgs::Float64MultiArrayConstPtr &msg);
+    void vector3AttitudeCallback(const geometry_msgs::Vector3StampedConstPtr &msg);
+    void publish();
+
+    MixerEngine mixer;
+    std::vector<int> attitudeInputs;
+
+    std::mutex mutex;
+    MixerEngine::InputVector input;
+    bool thrustReceived, attitudeReceived;
+
+    ros::Subscriber thrustSub, attitudeSub;
+    ros::Publisher motorsPub;
+};
+
+}
+
+#endif // MMUAV_CONTROL_MIXER_NODELET_H
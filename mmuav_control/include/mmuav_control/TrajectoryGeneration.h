@@ -0,0 +1,51 @@
+/******************************************************************************
+File name: TrajectoryGeneration.h
+Description: ROS service and topic interface of the minimum snap trajectory
+    generator.
+******************************************************************************/
+
+#ifndef MMUAV_CONTROL_TRAJECTORY_GENERATION_H
+#define MMUAV_CONTROL_TRAJECTORY_GENERATION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <trajectory_msgs/MultiDOFJointTrajectory.h>
+#include <mmuav_msgs/GenerateTrajectory.h>
+
+#include <mmuav_control/MinSnapTrajectory.h>
+
+class TrajectoryGeneration
+{
+public:
+    TrajectoryGeneration();
+    void run();
+
+private:
+    bool generateCallback(mmuav_msgs::GenerateTrajectory::Request &req,
+        mmuav_msgs::GenerateTrajectory::Response &res);
+    void keyframesCallback(const trajectory_msgs::MultiDOFJointTrajectory &msg);
+
+    // Plans through keyframes and samples the result into trajectory.
+    bool generate(const trajectory_msgs::MultiDOFJointTrajectory &keyframes,
+        int replanFromSegment, double samplingFrequency,
+        trajectory_msgs::MultiDOFJointTrajectory &trajectory, std::string &message);
+    std::vector<double> segmentDurations(const trajectory_msgs::MultiDOFJointTrajectory &keyframes,
+        const TrajectoryMatrix &points) const;
+    void toMessage(const PolynomialTrajectory &polynomial, double samplingFrequency,
+        trajectory_msgs::MultiDOFJointTrajectory &trajectory) const;
+
+    ros::NodeHandle nhParams, nhTopics;
+    ros::ServiceServer generateService;
+    ros::Subscriber keyframesSub;
+    ros::Publisher trajectoryPub;
+
+    double rate, maxVelocity, maxYawRate, minSegmentDuration;
+    std::unique_ptr<MinSnapTrajectoryGenerator> generator;
+    // Last generated trajectory, the base of tail replanning.
+    PolynomialTrajectory lastTrajectory;
+};
+
+#endif // MMUAV_CONTROL_TRAJECTORY_GENERATION_H
@@ -0,0 +1,217 @@
+/******************************************************************************
+File name: DualArmKinematics.cpp
+Description: Kinematics of the two 2R arms joined by a passive joint at the
+    end effector.
+******************************************************************************/
+
+#include <mmuav_control/DualArmKinematics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace
+{
+
+// Smallest batch worth starting a thread for.
+const size_t kMinGoalsPerThread = 64;
+
+double wrapAngle(double angle)
+{
+    return std::atan2(std::sin(angle), std::cos(angle));
+}
+
+}
+
+DualArmKinematics::DualArmKinematics(const DualArmGeometry &geometry):
+    geometry_(geometry),
+    gridResolution_(0.0),
+    gridOrigin_(Eigen::Vector2d::Zero()),
+    gridWidth_(0),
+    gridHeight_(0)
+{
+    int steps = std::max(0, (int)std::floor((geometry_.phiMax - geometry_.phiMin) /
+        geometry_.phiStep + 1e-9));
+    for (int i = 0; i <= steps; i++) phis_.push_back(geometry_.phiMin + i * geometry_.phiStep);
+}
+
+Eigen::Matrix4d DualArmKinematics::dhTransform(double theta, double d, double alpha, double a)
+{
+    double ct = cos(theta), st = sin(theta), ca = cos(alpha), sa = sin(alpha);
+    Eigen::Matrix4d T;
+    T << ct, -ca * st,  sa * st, a * ct,
+         st,  ca * ct, -sa * ct, a * st,
+        0.0,       sa,       ca,      d,
+        0.0,      0.0,      0.0,    1.0;
+    return T;
+}
+
+Eigen::Matrix4d DualArmKinematics::forwardKinematics(double q1, double q2) const
+{
+    return dhTransform(q1, 0.0, 0.0, geometry_.l1) * dhTransform(q2, 0.0, 0.0, geometry_.l2);
+}
+
+bool DualArmKinematics::inverseKinematics2R(const Eigen::Vector2d &goal,
+    Eigen::Matrix<double, 3, 2> &q) const
+{
+    const double l1 = geometry_.l1, l2 = geometry_.l2;
+    double c2 = (goal.squaredNorm() - l1 * l1 - l2 * l2) / (2.0 * l1 * l2);
+    if (c2 > 1.0 + 1e-12 || c2 < -1.0 - 1e-12) return false;
+    c2 = std::max(-1.0, std::min(c2, 1.0));
+
+    for (int i = 0; i < 2; i++)
+    {
+        q(1, i) = i ? acos(c2) : -acos(c2);
+        double p1 = l1 + l2 * cos(q(1, i));
+        double p2 = l2 * sin(q(1, i));
+        q(0, i) = atan2(p1 * goal.y() - p2 * goal.x(), p1 * goal.x() + p2 * goal.y());
+        q(2, i) = -(q(0, i) + q(1, i));
+    }
+    return true;
+}
+
+bool DualArmKinematics::closestInverseKinematics2R(const Eigen::Vector3d &qStart,
+    const Eigen::Vector2d &goal, Eigen::Vector3d &q) const
+{
+    Eigen::Matrix<double, 3, 2> solutions;
+    if (!inverseKinematics2R(goal, solutions)) return false;
+
+    double minDistance = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < 2; i++)
+    {
+        Eigen::Vector2d reached = forwardKinematics(solutions(0, i), solutions(1, i)).block<2, 1>(0, 3);
+        if ((reached - goal).norm() > 1e-6) continue;
+
+        Eigen::Vector3d difference = qStart - solutions.col(i);
+        for (int j = 0; j < 3; j++) difference(j) = wrapAngle(difference(j));
+        if (difference.norm() < minDistance)
+        {
+            minDistance = difference.norm();
+            q = solutions.col(i);
+        }
+    }
+    return minDistance < std::numeric_limits<double>::infinity();
+}
+
+void DualArmKinematics::armGoals(const Eigen::Vector2d &goal, double phi,
+    Eigen::Vector2d &goalA, Eigen::Vector2d &goalB) const
+{
+    double reach = geometry_.l1 + geometry_.l2 - geometry_.l3 * cos(phi);
+    double offset = geometry_.l3 * sin(phi);
+    goalA << goal.x() + reach, -(goal.y() + offset);
+    goalB << -goal.x() + reach, goal.y() - offset;
+}
+
+bool DualArmKinematics::solve(const Eigen::Vector3d &qA, const Eigen::Vector3d &qB,
+    const Eigen::Vector2d &goal, Eigen::Vector3d &solutionA, Eigen::Vector3d &solutionB) const
+{
+    // Passive joint starts at zero for the distance, as in ik_both_arms.
+    Eigen::Vector3d startA(qA(0), qA(1), 0.0), startB(qB(0), qB(1), 0.0);
+    Eigen::Vector2d goalA, goalB;
+    Eigen::Vector3d a, b;
+    double minDistance = std::numeric_limits<double>::infinity();
+
+    for (size_t i = 0; i < phis_.size(); i++)
+    {
+        armGoals(goal, phis_[i], goalA, goalB);
+        if (!closestInverseKinematics2R(startA, goalA, a) ||
+            !closestInverseKinematics2R(startB, goalB, b))
+            continue;
+
+        double distance = (a - startA).squaredNorm() + (b - startB).squaredNorm();
+        if (distance < minDistance)
+        {
+            minDistance = distance;
+            solutionA << a(0), a(1), -phis_[i];
+            solutionB << b(0), b(1), -phis_[i];
+        }
+    }
+    return minDistance < std::numeric_limits<double>::infinity();
+}
+
+void DualArmKinematics::buildReachabilityGrid(double resolution)
+{
+    const double l1 = geometry_.l1, l2 = geometry_.l2, l3 = geometry_.l3;
+    gridResolution_ = resolution;
+    // Every reachable goal lies within these bounds.
+    double halfWidth = 2.0 * (l1 + l2) + l3 + resolution;
+    double halfHeight = l1 + l2 + l3 + resolution;
+    gridOrigin_ << -halfWidth, -halfHeight;
+    gridWidth_ = (int)std::ceil(2.0 * halfWidth / resolution);
+    gridHeight_ = (int)std::ceil(2.0 * halfHeight / resolution);
+    grid_.assign(gridWidth_ * gridHeight_, 0);
+
+    double margin = 0.5 * sqrt(2.0) * resolution;
+    double minRadius = std::max(0.0, fabs(l1 - l2) - margin);
+    double maxRadius = l1 + l2 + margin;
+    Eigen::Vector2d center, goalA, goalB;
+    for (int y = 0; y < gridHeight_; y++)
+    {
+        for (int x = 0; x < gridWidth_; x++)
+        {
+            center = gridOrigin_ + resolution * Eigen::Vector2d(x + 0.5, y + 0.5);
+            for (size_t i = 0; i < phis_.size(); i++)
+            {
+                armGoals(center, phis_[i], goalA, goalB);
+                double rA = goalA.norm(), rB = goalB.norm();
+                if (rA >= minRadius && rA <= maxRadius && rB >= minRadius && rB <= maxRadius)
+                {
+                    grid_[y * gridWidth_ + x] = 1;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool DualArmKinematics::maybeReachable(const Eigen::Vector2d &goal) const
+{
+    if (grid_.empty()) return true;
+    Eigen::Vector2d cell = (goal - gridOrigin_) / gridResolution_;
+    int x = (int)std::floor(cell.x()), y = (int)std::floor(cell.y());
+    if (x < 0 || y < 0 || x >= gridWidth_ || y >= gridHeight_) return false;
+    return grid_[y * gridWidth_ + x] != 0;
+}
+
+void DualArmKinematics::solveRange(const GoalVector &goals, const Eigen::Vector3d &qA,
+    const Eigen::Vector3d &qB, bool checkOnly, size_t begin, size_t end,
+    std::vector<uint8_t> &reachable, JointVector &solutionsA, JointVector &solutionsB) const
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        solutionsA[i].setZero();
+        solutionsB[i].setZero();
+        bool ok = maybeReachable(goals[i]);
+        if (ok && !checkOnly) ok = solve(qA, qB, goals[i], solutionsA[i], solutionsB[i]);
+        reachable[i] = ok;
+    }
+}
+
+void DualArmKinematics::solveBatch(const GoalVector &goals, const Eigen::Vector3d &qA,
+    const Eigen::Vector3d &qB, bool checkOnly, int threads, std::vector<uint8_t> &reachable,
+    JointVector &solutionsA, JointVector &solutionsB) const
+{
+    size_t count = goals.size();
+    reachable.resize(count);
+    solutionsA.resize(count);
+    solutionsB.resize(count);
+
+    size_t workers = std::max(1, threads);
+    workers = std::min(workers, std::max(count / kMinGoalsPerThread, size_t(1)));
+    if (workers == 1)
+    {
+        solveRange(goals, qA, qB, checkOnly, 0, count, reachable, solutionsA, solutionsB);
+        return;
+    }
+
+    // Contiguous chunks, every thread writes only its own part of the outputs.
+    std::vector<std::thread> pool;
+    size_t chunk = (count + workers - 1) / workers;
+    for (size_t begin = chunk; begin < count; begin += chunk)
+        pool.push_back(std::thread(&DualArmKinematics::solveRange, this, std::cref(goals),
+            std::cref(qA), std::cref(qB), checkOnly, begin, std::min(begin + chunk, count),
+            std::ref(reachable), std::ref(solutionsA), std::ref(solutionsB)));
+    solveRange(goals, qA, qB, checkOnly, 0, std::min(chunk, count), reachable, solutionsA, solutionsB);
+    for (size_t i = 0; i < pool.size(); i++) pool[i].join();
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+File name: DualArmKinematicsServer.cpp
+Description: ROS service for batched dual arm inverse kinematics.
+******************************************************************************/
+
+#include <mmuav_control/DualArmKinematicsServer.h>
+
+#include <cmath>
+#include <thread>
+
+DualArmKinematicsServer::DualArmKinematicsServer()
+{
+    // Defaults are the arms of mmuav_attitude_control.py.
+    DualArmGeometry geometry;
+    double phiMin, phiMax, phiStep, gridResolution;
+    nhParams = ros::NodeHandle("~");
+    nhParams.param("l1", geometry.l1, 0.094);
+    nhParams.param("l2", geometry.l2, 0.061);
+    nhParams.param("l3", geometry.l3, 0.08);
+    nhParams.param("phi_min", phiMin, -65.0);
+    nhParams.param("phi_max", phiMax, -35.0);
+    nhParams.param("phi_step", phiStep, 3.0);
+    nhParams.param("grid_resolution", gridResolution, 0.002);
+    nhParams.param("threads", threads, (int)std::thread::hardware_concurrency());
+    geometry.phiMin = phiMin * M_PI / 180.0;
+    geometry.phiMax = phiMax * M_PI / 180.0;
+    geometry.phiStep = phiStep * M_PI / 180.0;
+
+    kinematics.reset(new DualArmKinematics(geometry));
+    if (gridResolution > 0.0) kinematics->buildReachabilityGrid(gridResolution);
+
+    inverseKinematicsService = nhTopics.advertiseService("dual_arm_inverse_kinematics",
+        &DualArmKinematicsServer::inverseKinematicsCallback, this);
+}
+
+void DualArmKinematicsServer::run()
+{
+    ros::spin();
+}
+
+bool DualArmKinematicsServer::inverseKinematicsCallback(
+    mmuav_msgs::DualArmInverseKinematics::Request &req,
+    mmuav_msgs::DualArmInverseKinematics::Response &res)
+{
+    GoalVector goals(req.goals.size());
+    for (size_t i = 0; i < goals.size(); i++) goals[i] << req.goals[i].x, req.goals[i].y;
+    Eigen::Vector3d qA(req.arm_a_joints[0], req.arm_a_joints[1], req.arm_a_joints[2]);
+    Eigen::Vector3d qB(req.arm_b_joints[0], req.arm_b_joints[1], req.arm_b_joints[2]);
+
+    std::vector<uint8_t> reachable;
+    JointVector solutionsA, solutionsB;
+    kinematics->solveBatch(goals, qA, qB, req.check_only, threads, reachable,
+        solutionsA, solutionsB);
+
+    res.reachable.assign(reachable.begin(), reachable.end());
+    res.arm_a_solutions.resize(3 * goals.size());
+    res.arm_b_solutions.resize(3 * goals.size());
+    for (size_t i = 0; i < goals.size(); i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            res.arm_a_solutions[3 * i + j] = solutionsA[i](j);
+            res.arm_b_solutions[3 * i + j] = solutionsB[i](j);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,355 @@
+/******************************************************************************
+File name: MinSnapTrajectory.cpp
+Description: Minimum snap polynomial trajectory generation through keyframes.
+******************************************************************************/
+
+#include <mmuav_control/MinSnapTrajectory.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// n! / (n - k)!, the factor in front of t^(n-k) in the k-th derivative of t^n.
+double fallingFactorial(int n, int k)
+{
+    double result = 1.0;
+    for (int i = 0; i < k; i++) result *= n - i;
+    return result;
+}
+
+// Derivative of one polynomial segment (all columns) at time t.
+Eigen::Matrix<double, 1, 4> evaluate(const TrajectoryMatrix &coefficients, int derivative, double t)
+{
+    Eigen::Matrix<double, 1, 4> value = Eigen::Matrix<double, 1, 4>::Zero();
+    double power = 1.0;
+    for (int i = derivative; i < coefficients.rows(); i++)
+    {
+        value += fallingFactorial(i, derivative) * power * coefficients.row(i);
+        power *= t;
+    }
+    return value;
+}
+
+double wrapAngle(double angle)
+{
+    return std::atan2(std::sin(angle), std::cos(angle));
+}
+
+}
+
+double PolynomialTrajectory::duration() const
+{
+    double total = 0.0;
+    for (size_t i = 0; i < durations.size(); i++) total += durations[i];
+    return total;
+}
+
+TrajectoryMatrix PolynomialTrajectory::knotDerivatives(int segment, int derivativeCount) const
+{
+    TrajectoryMatrix result(derivativeCount, 4);
+    bool last = segment >= segmentCount();
+    int index = last ? segmentCount() - 1 : segment;
+    double t = last ? durations[index] : 0.0;
+    for (int d = 0; d < derivativeCount; d++)
+        result.row(d) = evaluate(coefficients[index], d, t);
+    return result;
+}
+
+void PolynomialTrajectory::sample(double dt, std::vector<double> &times,
+    TrajectoryMatrix &position, TrajectoryMatrix &velocity,
+    TrajectoryMatrix &acceleration) const
+{
+    double total = duration();
+    int count = static_cast<int>(std::floor(total / dt + 1e-9)) + 1;
+    bool addEnd = total - (count - 1) * dt > 1e-9;
+    if (addEnd) count++;
+
+    times.resize(count);
+    position.resize(count, 4);
+    velocity.resize(count, 4);
+    acceleration.resize(count, 4);
+    for (int i = 0; i < count; i++) times[i] = std::min(i * dt, total);
+
+    int first = 0;
+    double segmentStart = 0.0;
+    for (int k = 0; k < segmentCount() && first < count; k++)
+    {
+        // Samples that fall into this segment, the last segment takes the rest.
+        double segmentEnd = segmentStart + durations[k];
+        int last = first;
+        while (last < count && (times[last] < segmentEnd || k == segmentCount() - 1)) last++;
+        int rows = last - first;
+        if (rows == 0)
+        {
+            segmentStart = segmentEnd;
+            continue;
+        }
+
+        const TrajectoryMatrix &c = coefficients[k];
+        int n = c.rows();
+        Eigen::MatrixXd basis(rows, n), basisVelocity(rows, n), basisAcceleration(rows, n);
+        Eigen::VectorXd tau(rows);
+        for (int j = 0; j < rows; j++) tau(j) = times[first + j] - segmentStart;
+
+        basis.col(0).setOnes();
+        for (int i = 1; i < n; i++) basis.col(i) = basis.col(i - 1).cwiseProduct(tau);
+        basisVelocity.col(0).setZero();
+        basisAcceleration.col(0).setZero();
+        if (n > 1) basisAcceleration.col(1).setZero();
+        for (int i = 1; i < n; i++) basisVelocity.col(i) = i * basis.col(i - 1);
+        for (int i = 2; i < n; i++) basisAcceleration.col(i) = i * (i - 1) * basis.col(i - 2);
+
+        position.middleRows(first, rows).noalias() = basis * c;
+        velocity.middleRows(first, rows).noalias() = basisVelocity * c;
+        acceleration.middleRows(first, rows).noalias() = basisAcceleration * c;
+
+        first = last;
+        segmentStart = segmentEnd;
+    }
+}
+
+MinSnapTrajectoryGenerator::MinSnapTrajectoryGenerator(int polynomialOrder,
+    int positionDerivative, int yawDerivative, size_t cacheCapacity):
+    polynomialOrder_(polynomialOrder),
+    derivativeCount_((polynomialOrder + 1) / 2),
+    positionDerivative_(positionDerivative),
+    yawDerivative_(yawDerivative),
+    cacheCapacity_(std::max(cacheCapacity, size_t(1)))
+{
+}
+
+size_t MinSnapTrajectoryGenerator::cacheSize()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    return cache_.size();
+}
+
+std::vector<double> MinSnapTrajectoryGenerator::estimateDurations(
+    const TrajectoryMatrix &keyframes, double maxVelocity, double maxYawRate,
+    double minDuration)
+{
+    std::vector<double> durations;
+    for (int i = 1; i < keyframes.rows(); i++)
+    {
+        double distance = (keyframes.block<1, 3>(i, 0) - keyframes.block<1, 3>(i - 1, 0)).norm();
+        double yaw = std::fabs(wrapAngle(keyframes(i, 3) - keyframes(i - 1, 3)));
+        // A polynomial at rest on both ends peaks at roughly twice its mean velocity.
+        double duration = 2.0 * distance / maxVelocity;
+        if (maxYawRate > 0.0) duration = std::max(duration, 2.0 * yaw / maxYawRate);
+        durations.push_back(std::max(duration, minDuration));
+    }
+    return durations;
+}
+
+bool MinSnapTrajectoryGenerator::generate(const TrajectoryMatrix &keyframes,
+    const std::vector<double> &durations, PolynomialTrajectory &trajectory)
+{
+    if (keyframes.rows() < 2) return false;
+    TrajectoryMatrix start = TrajectoryMatrix::Zero(derivativeCount_, 4);
+    start.row(0) = keyframes.row(0);
+    trajectory.durations.clear();
+    trajectory.coefficients.clear();
+    return plan(keyframes, durations, start, trajectory);
+}
+
+bool MinSnapTrajectoryGenerator::replanTail(const PolynomialTrajectory &current,
+    int firstSegment, const TrajectoryMatrix &keyframes,
+    const std::vector<double> &durations, PolynomialTrajectory &trajectory)
+{
+    if (firstSegment <= 0 || current.segmentCount() == 0)
+        return generate(keyframes, durations, trajectory);
+    if (firstSegment > current.segmentCount() || keyframes.rows() < 2) return false;
+
+    TrajectoryMatrix start = current.knotDerivatives(firstSegment, derivativeCount_);
+    PolynomialTrajectory result;
+    result.durations.assign(current.durations.begin(), current.durations.begin() + firstSegment);
+    result.coefficients.assign(current.coefficients.begin(), current.coefficients.begin() + firstSegment);
+    if (!plan(keyframes, durations, start, result)) return false;
+    trajectory = result;
+    return true;
+}
+
+bool MinSnapTrajectoryGenerator::plan(const TrajectoryMatrix &keyframes,
+    const std::vector<double> &durations, const TrajectoryMatrix &startDerivatives,
+    PolynomialTrajectory &trajectory)
+{
+    int segments = keyframes.rows() - 1;
+    if (segments < 1 || (int)durations.size() != segments) return false;
+    for (int k = 0; k < segments; k++)
+        if (!(durations[k] > 0.0)) return false;
+
+    std::shared_ptr<const Structure> position = getStructure(durations, positionDerivative_);
+    std::shared_ptr<const Structure> yaw = getStructure(durations, yawDerivative_);
+    if (!position || !yaw) return false;
+
+    // Yaw keyframes are unwrapped so the trajectory turns the short way.
+    Eigen::VectorXd yawKeyframes(keyframes.rows());
+    yawKeyframes(0) = startDerivatives(0, 3);
+    for (int i = 1; i < keyframes.rows(); i++)
+        yawKeyframes(i) = yawKeyframes(i - 1) + wrapAngle(keyframes(i, 3) - yawKeyframes(i - 1));
+
+    // Fixed derivatives: full state of the first knot, positions, the last knot at rest.
+    const int D = derivativeCount_;
+    Eigen::MatrixXd positionFixed(position->fixedCount, 3), yawFixed(yaw->fixedCount, 1);
+    for (int knot = 0; knot <= segments; knot++)
+    {
+        for (int d = 0; d < D; d++)
+        {
+            int variable = knot * D + d;
+            Eigen::Matrix<double, 1, 4> value = Eigen::Matrix<double, 1, 4>::Zero();
+            if (knot == 0) value = startDerivatives.row(d);
+            else if (d == 0) value << keyframes.block<1, 3>(knot, 0), yawKeyframes(knot);
+
+            if (!position->variableFree[variable])
+                positionFixed.row(position->variableIndex[variable]) = value.head<3>();
+            if (!yaw->variableFree[variable])
+                yawFixed(yaw->variableIndex[variable], 0) = value(3);
+        }
+    }
+
+    Eigen::MatrixXd positionKnots, yawKnots;
+    if (!solve(*position, positionFixed, positionKnots) || !solve(*yaw, yawFixed, yawKnots))
+        return false;
+
+    for (int k = 0; k < segments; k++)
+    {
+        TrajectoryMatrix c(polynomialOrder_ + 1, 4);
+        c.leftCols<3>() = position->inverseA[k] * positionKnots.middleRows(k * D, 2 * D);
+        c.col(3) = yaw->inverseA[k] * yawKnots.middleRows(k * D, 2 * D);
+        trajectory.durations.push_back(durations[k]);
+        trajectory.coefficients.push_back(c);
+    }
+    return true;
+}
+
+bool MinSnapTrajectoryGenerator::solve(const Structure &structure,
+    const Eigen::MatrixXd &fixedValues, Eigen::MatrixXd &knots) const
+{
+    Eigen::MatrixXd freeValues;
+    if (structure.freeCount > 0)
+    {
+        Eigen::MatrixXd rhs = -(structure.freeFixed * fixedValues);
+        freeValues = structure.freeSolver.solve(rhs);
+        if (structure.freeSolver.info() != Eigen::Success) return false;
+    }
+
+    int variables = structure.variableFree.size();
+    knots.resize(variables, fixedValues.cols());
+    for (int v = 0; v < variables; v++)
+    {
+        if (structure.variableFree[v]) knots.row(v) = freeValues.row(structure.variableIndex[v]);
+        else knots.row(v) = fixedValues.row(structure.variableIndex[v]);
+    }
+    return true;
+}
+
+std::shared_ptr<const MinSnapTrajectoryGenerator::Structure>
+MinSnapTrajectoryGenerator::getStructure(const std::vector<double> &durations, int costDerivative)
+{
+    StructureKey key(costDerivative, durations);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto it = cache_.find(key);
+        if (it != cache_.end()) return it->second;
+    }
+
+    // Built outside of the lock, a concurrent build of the same key is harmless.
+    std::shared_ptr<Structure> structure = buildStructure(durations, costDerivative);
+    if (!structure) return structure;
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    if (cache_.insert(std::make_pair(key, structure)).second)
+    {
+        cacheOrder_.push_back(key);
+        while (cache_.size() > cacheCapacity_)
+        {
+            cache_.erase(cacheOrder_.front());
+            cacheOrder_.pop_front();
+        }
+    }
+    return structure;
+}
+
+std::shared_ptr<MinSnapTrajectoryGenerator::Structure>
+MinSnapTrajectoryGenerator::buildStructure(const std::vector<double> &durations,
+    int costDerivative) const
+{
+    const int D = derivativeCount_;
+    const int n = polynomialOrder_ + 1;
+    const int segments = durations.size();
+    const int variables = (segments + 1) * D;
+    if (polynomialOrder_ % 2 == 0 || costDerivative >= D) return std::shared_ptr<Structure>();
+
+    std::shared_ptr<Structure> structure(new Structure());
+    structure->variableIndex.resize(variables);
+    structure->variableFree.resize(variables);
+    structure->freeCount = 0;
+    structure->fixedCount = 0;
+    for (int knot = 0; knot <= segments; knot++)
+    {
+        for (int d = 0; d < D; d++)
+        {
+            int v = knot * D + d;
+            bool free = knot > 0 && knot < segments && d > 0;
+            structure->variableFree[v] = free;
+            structure->variableIndex[v] = free ? structure->freeCount++ : structure->fixedCount++;
+        }
+    }
+
+    std::vector<Eigen::Triplet<double> > freeFree, freeFixed;
+    structure->inverseA.resize(segments);
+    for (int k = 0; k < segments; k++)
+    {
+        double T = durations[k];
+
+        // Maps coefficients to the derivatives at both ends of the segment.
+        Eigen::MatrixXd A = Eigen::MatrixXd::Zero(n, n);
+        for (int d = 0; d < D; d++)
+        {
+            A(d, d) = fallingFactorial(d, d);
+            for (int i = d; i < n; i++)
+                A(D + d, i) = fallingFactorial(i, d) * std::pow(T, i - d);
+        }
+        structure->inverseA[k] = A.partialPivLu().inverse();
+
+        // Integral of the squared costDerivative over the segment.
+        Eigen::MatrixXd Q = Eigen::MatrixXd::Zero(n, n);
+        for (int i = costDerivative; i < n; i++)
+        {
+            for (int j = costDerivative; j < n; j++)
+            {
+                int power = i + j - 2 * costDerivative + 1;
+                Q(i, j) = fallingFactorial(i, costDerivative) * fallingFactorial(j, costDerivative) *
+                    std::pow(T, power) / power;
+            }
+        }
+
+        const Eigen::MatrixXd &Ainv = structure->inverseA[k];
+        Eigen::MatrixXd H = Ainv.transpose() * Q * Ainv;
+        for (int a = 0; a < 2 * D; a++)
+        {
+            int va = k * D + a;
+            if (!structure->variableFree[va]) continue;
+            for (int b = 0; b < 2 * D; b++)
+            {
+                int vb = k * D + b;
+                Eigen::Triplet<double> entry(structure->variableIndex[va], structure->variableIndex[vb], H(a, b));
+                if (structure->variableFree[vb]) freeFree.push_back(entry);
+                else freeFixed.push_back(entry);
+            }
+        }
+    }
+
+    if (structure->freeCount > 0)
+    {
+        Eigen::SparseMatrix<double> R(structure->freeCount, structure->freeCount);
+        R.setFromTriplets(freeFree.begin(), freeFree.end());
+        structure->freeSolver.compute(R);
+        if (structure->freeSolver.info() != Eigen::Success) return std::shared_ptr<Structure>();
+    }
+    structure->freeFixed.resize(structure->freeCount, structure->fixedCount);
+    structure->freeFixed.setFromTriplets(freeFixed.begin(), freeFixed.end());
+    return structure;
+}
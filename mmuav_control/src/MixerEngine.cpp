@@ -0,0 +1,265 @@
+/******************************************************************************
+File name: MixerEngine.cpp
+Description: Maps controller outputs to motor velocities with a precomputed
+    allocation matrix.
+******************************************************************************/
+
+#include <mmuav_control/MixerEngine.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+// Pixhawk mixer scalers are integers in units of 1/10000.
+const double kPixhawkScale = 1e-4;
+
+bool readNumbers(std::istringstream &line, int count, std::vector<double> &numbers)
+{
+    numbers.resize(count);
+    for (int i = 0; i < count; i++)
+        if (!(line >> numbers[i])) return false;
+    return true;
+}
+
+// Reads the rest of the line, false if a token is not a number.
+bool readAllNumbers(std::istringstream &line, std::vector<double> &numbers)
+{
+    numbers.clear();
+    std::string token;
+    while (line >> token)
+    {
+        char *end;
+        double value = std::strtod(token.c_str(), &end);
+        if (end == token.c_str() || *end != '\0') return false;
+        numbers.push_back(value);
+    }
+    return true;
+}
+
+}
+
+MixerEngine::MixerEngine()
+{
+    clear();
+}
+
+void MixerEngine::clear()
+{
+    inputCount_ = 0;
+    outputCount_ = 0;
+    allocation_.setZero();
+    offset_.setZero();
+    // Outputs that are not defined stay zero.
+    negativeScale_.setZero();
+    positiveScale_.setZero();
+    outputOffset_.setZero();
+    lower_.setZero();
+    upper_.setZero();
+}
+
+bool MixerEngine::load(const std::string &fileName, std::string &error, std::string &warning)
+{
+    std::ifstream in(fileName.c_str());
+    if (!in)
+    {
+        error = "can not open mixer file " + fileName;
+        return false;
+    }
+    return parse(in, error, warning);
+}
+
+bool MixerEngine::parse(std::istream &in, std::string &error, std::string &warning)
+{
+    clear();
+    error.clear();
+    warning.clear();
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    // Terms still expected by the current Pixhawk mixer, -1 before its O: line.
+    int pendingTerms = 0;
+    int declaredTerms = 0;
+    // Coefficients per W: row, all rows of a file must have the same count.
+    int rowLength = -1;
+    int lineNumber = 0;
+    std::string text;
+    std::vector<double> numbers;
+    while (std::getline(in, text))
+    {
+        lineNumber++;
+        std::istringstream line(text);
+        std::string tag;
+        if (!(line >> tag) || tag.size() != 2 || tag[1] != ':') continue;
+
+        std::ostringstream where;
+        where << "line " << lineNumber << ": ";
+        char type = tag[0];
+        if (type == 'R')
+        {
+            // R: is the Pixhawk multirotor mixer, which names a geometry instead of a matrix.
+            error = where.str() + "R: multirotor mixers are not supported, give the rows as W: lines";
+            return false;
+        }
+        if (type != 'O' && type != 'S' && type != 'L' && type != 'M' && type != 'Z' && type != 'W')
+            continue;
+
+        if ((type == 'O' && pendingTerms >= 0) || (type == 'S' && pendingTerms <= 0) ||
+            ((type == 'M' || type == 'Z' || type == 'W') && pendingTerms != 0))
+        {
+            error = where.str() + "unexpected " + tag + " in the middle of a mixer";
+            return false;
+        }
+
+        if (type == 'M' || type == 'Z' || type == 'W')
+        {
+            if (outputCount_ == kMaxOutputs)
+            {
+                error = where.str() + "too many outputs";
+                return false;
+            }
+            int o = outputCount_++;
+            negativeScale_(o) = 1.0;
+            positiveScale_(o) = 1.0;
+            lower_(o) = -infinity;
+            upper_(o) = infinity;
+
+            if (type == 'M')
+            {
+                if (!(line >> declaredTerms) || declaredTerms < 0)
+                {
+                    error = where.str() + "M: needs the number of controls";
+                    return false;
+                }
+                pendingTerms = -1;
+            }
+            else if (type == 'W')
+            {
+                if (!readAllNumbers(line, numbers) || numbers.empty())
+                {
+                    error = where.str() + "W: needs one number per input";
+                    return false;
+                }
+                int count = numbers.size();
+                if (count > kMaxInputs)
+                {
+                    error = where.str() + "too many inputs";
+                    return false;
+                }
+                if (rowLength >= 0 && count != rowLength)
+                {
+                    std::ostringstream message;
+                    message << where.str() << "W: has " << count << " coefficients, the rows before have " << rowLength;
+                    error = message.str();
+                    return false;
+                }
+                rowLength = count;
+                for (int input = 0; input < count; input++)
+                {
+                    allocation_(o, input) = numbers[input];
+                    allocation_(o, kMaxInputs + input) = numbers[input];
+                }
+                inputCount_ = std::max(inputCount_, count);
+            }
+            else
+            {
+                lower_(o) = 0.0;
+                upper_(o) = 0.0;
+            }
+        }
+        else if (type == 'O')
+        {
+            int o = outputCount_ - 1;
+            if (!readNumbers(line, 5, numbers))
+            {
+                error = where.str() + "O: needs five values";
+                return false;
+            }
+            pendingTerms = declaredTerms;
+            negativeScale_(o) = numbers[0] * kPixhawkScale;
+            positiveScale_(o) = numbers[1] * kPixhawkScale;
+            outputOffset_(o) = numbers[2] * kPixhawkScale;
+            lower_(o) = numbers[3] * kPixhawkScale;
+            upper_(o) = numbers[4] * kPixhawkScale;
+        }
+        else if (type == 'S')
+        {
+            int o = outputCount_ - 1;
+            int group, index;
+            if (!(line >> group >> index) || !readNumbers(line, 5, numbers))
+            {
+                error = where.str() + "S: needs group, index and five values";
+                return false;
+            }
+            int input = 8 * group + index;
+            if (group < 0 || index < 0 || index >= 8 || input >= kMaxInputs)
+            {
+                error = where.str() + "control group or index out of range";
+                return false;
+            }
+            double negative = numbers[0] * kPixhawkScale;
+            double positive = numbers[1] * kPixhawkScale;
+            double offset = numbers[2] * kPixhawkScale;
+            allocation_(o, input) += positive;
+            allocation_(o, kMaxInputs + input) += negative;
+            offset_(o) += offset;
+            inputCount_ = std::max(inputCount_, input + 1);
+
+            double lowest = std::min(std::min(-negative, positive), 0.0) + offset;
+            double highest = std::max(std::max(-negative, positive), 0.0) + offset;
+            if (lowest < numbers[3] * kPixhawkScale - 1e-9 || highest > numbers[4] * kPixhawkScale + 1e-9)
+                warning = where.str() + "term limits are not applied by the compiled mixer";
+            pendingTerms--;
+        }
+        else if (type == 'L')
+        {
+            if (outputCount_ == 0 || !readNumbers(line, 2, numbers))
+            {
+                error = where.str() + "L: needs an output and two values";
+                return false;
+            }
+            lower_(outputCount_ - 1) = numbers[0];
+            upper_(outputCount_ - 1) = numbers[1];
+        }
+    }
+
+    if (pendingTerms != 0)
+    {
+        error = "mixer file ends in the middle of a mixer";
+        return false;
+    }
+    if (outputCount_ == 0)
+    {
+        error = "mixer file has no outputs";
+        return false;
+    }
+    return true;
+}
+
+MixerEngine::SplitVector MixerEngine::split(const InputVector &input) const
+{
+    SplitVector v;
+    v.head<kMaxInputs>() = input.cwiseMax(0.0);
+    v.tail<kMaxInputs>() = input.cwiseMin(0.0);
+    return v;
+}
+
+void MixerEngine::mix(const InputVector &input, OutputVector &output) const
+{
+    OutputVector sum = allocation_ * split(input) + offset_;
+    output = (sum.array() < 0.0).select(sum.cwiseProduct(negativeScale_),
+        sum.cwiseProduct(positiveScale_)) + outputOffset_;
+    output = output.cwiseMax(lower_).cwiseMin(upper_);
+}
+
+double MixerEngine::mix(const InputVector &input, int output) const
+{
+    double sum = allocation_.row(output).dot(split(input)) + offset_(output);
+    sum = sum < 0.0 ? sum * negativeScale_(output) : sum * positiveScale_(output);
+    sum += outputOffset_(output);
+    return std::max(lower_(output), std::min(sum, upper_(output)));
+}
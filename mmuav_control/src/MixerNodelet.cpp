@@ -0,0 +1,133 @@
+/******************************************************************************
+File name: MixerNodelet.cpp
+Description: Nodelet mapping controller outputs to motor velocities.
+******************************************************************************/
+
+#include <mmuav_control/MixerNodelet.h>
+
+#include <pluginlib/class_list_macros.h>
+
+namespace mmuav_control
+{
+
+// Thrust input of the mixer, see MixerEngine.h.
+static const int kThrustInput = 3;
+
+// Mixer input of every attitude_command element, per attitude controller.
+// Returns false for an unknown controller.
+static bool controllerLayout(const std::string &controller, bool &vector3Attitude,
+    std::vector<int> &inputs)
+{
+    // vpc_dfc, vpc_mmc, vpc_mmuav, vpc_rotorsuav and vpc_ttc:
+    // roll, pitch, yaw, vpc roll, vpc pitch.
+    static const int vpcInputs[] = {0, 1, 2, 4, 5};
+    // mmuav: left and right arm joints (not mixed), yaw, vpc roll, vpc pitch.
+    static const int mmuavInputs[] = {-1, -1, -1, -1, -1, -1, 2, 4, 5};
+    // rotors_variation: roll, pitch, yaw.
+    static const int rotorsVariationInputs[] = {0, 1, 2};
+
+    vector3Attitude = false;
+    inputs.clear();
+    if (controller == "vpc")
+        inputs.assign(vpcInputs, vpcInputs + 5);
+    else if (controller == "mmuav")
+        inputs.assign(mmuavInputs, mmuavInputs + 9);
+    else if (controller == "rotors_variation")
+        inputs.assign(rotorsVariationInputs, rotorsVariationInputs + 3);
+    // attitude_control and mmc_attitude_control publish a Vector3Stamped.
+    else if (controller == "vector3")
+        vector3Attitude = true;
+    else
+        return false;
+    return true;
+}
+
+MixerNodelet::MixerNodelet():
+    thrustReceived(false),
+    attitudeReceived(false)
+{
+    input.setZero();
+}
+
+void MixerNodelet::onInit()
+{
+    ros::NodeHandle &nh = getNodeHandle();
+    ros::NodeHandle &nhParams = getPrivateNodeHandle();
+
+    std::string mixerFile, controller, error, warning;
+    bool vector3Attitude;
+    std::vector<int> defaultInputs;
+    nhParams.param("mixer_file", mixerFile, std::string(""));
+    nhParams.param("controller", controller, std::string("vpc"));
+    if (!controllerLayout(controller, vector3Attitude, defaultInputs))
+    {
+        NODELET_ERROR("Unknown controller %s, expected vpc, mmuav, rotors_variation or vector3.",
+            controller.c_str());
+        return;
+    }
+    nhParams.param("vector3_attitude_command", vector3Attitude, vector3Attitude);
+    nhParams.param("attitude_command_inputs", attitudeInputs, defaultInputs);
+
+    if (!mixer.load(mixerFile, error, warning))
+    {
+        NODELET_ERROR("Mixer not loaded: %s", error.c_str());
+        return;
+    }
+    if (!warning.empty()) NODELET_WARN("Mixer %s: %s", mixerFile.c_str(), warning.c_str());
+    NODELET_INFO("Loaded mixer %s with %d inputs and %d outputs.", mixerFile.c_str(),
+        mixer.inputCount(), mixer.outputCount());
+
+    motorsPub = nh.advertise<mav_msgs::Actuators>("command/motors", 1);
+    thrustSub = nh.subscribe("mot_vel_ref", 1, &MixerNodelet::thrustCallback, this);
+    if (vector3Attitude)
+        attitudeSub = nh.subscribe("attitude_command", 1, &MixerNodelet::vector3AttitudeCallback, this);
+    else
+        attitudeSub = nh.subscribe("attitude_command", 1, &MixerNodelet::attitudeCallback, this);
+}
+
+void MixerNodelet::thrustCallback(const std_msgs::Float64ConstPtr &msg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    input(kThrustInput) = msg->data;
+    thrustReceived = true;
+    publish();
+}
+
+void MixerNodelet::attitudeCallback(const std_msgs::Float64MultiArrayConstPtr &msg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < msg->data.size() && i < attitudeInputs.size(); i++)
+    {
+        int index = attitudeInputs[i];
+        if (index >= 0 && index < MixerEngine::kMaxInputs) input(index) = msg->data[i];
+    }
+    attitudeReceived = true;
+    publish();
+}
+
+void MixerNodelet::vector3AttitudeCallback(const geometry_msgs::Vector3StampedConstPtr &msg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    input(0) = msg->vector.x;
+    input(1) = msg->vector.y;
+    input(2) = msg->vector.z;
+    attitudeReceived = true;
+    publish();
+}
+
+void MixerNodelet::publish()
+{
+    if (!thrustReceived || !attitudeReceived) return;
+
+    MixerEngine::OutputVector output;
+    mixer.mix(input, output);
+
+    mav_msgs::ActuatorsPtr msg(new mav_msgs::Actuators);
+    msg->header.stamp = ros::Time::now();
+    msg->angular_velocities.assign(output.data(), output.data() + mixer.outputCount());
+    motorsPub.publish(msg);
+}
+
+}
+
+PLUGINLIB_EXPORT_CLASS(mmuav_control::MixerNodelet, nodelet::Nodelet)
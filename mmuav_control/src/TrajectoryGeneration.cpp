@@ -0,0 +1,162 @@
+/******************************************************************************
+File name: TrajectoryGeneration.cpp
+Description: ROS service and topic interface of the minimum snap trajectory
+    generator.
+******************************************************************************/
+
+#include <mmuav_control/TrajectoryGeneration.h>
+
+#include <cmath>
+
+TrajectoryGeneration::TrajectoryGeneration()
+{
+    int polynomialOrder, cacheCapacity;
+    nhParams = ros::NodeHandle("~");
+    nhParams.param("rate", rate, 100.0);
+    nhParams.param("max_velocity", maxVelocity, 1.0);
+    nhParams.param("max_yaw_rate", maxYawRate, 1.0);
+    nhParams.param("min_segment_duration", minSegmentDuration, 0.5);
+    nhParams.param("polynomial_order", polynomialOrder, 9);
+    nhParams.param("cache_capacity", cacheCapacity, 64);
+    generator.reset(new MinSnapTrajectoryGenerator(polynomialOrder, 4, 2, cacheCapacity));
+
+    generateService = nhTopics.advertiseService("generate_trajectory",
+        &TrajectoryGeneration::generateCallback, this);
+    keyframesSub = nhTopics.subscribe("keyframes", 1,
+        &TrajectoryGeneration::keyframesCallback, this);
+    trajectoryPub = nhTopics.advertise<trajectory_msgs::MultiDOFJointTrajectory>(
+        "multi_dof_trajectory", 1);
+}
+
+void TrajectoryGeneration::run()
+{
+    ros::spin();
+}
+
+bool TrajectoryGeneration::generateCallback(mmuav_msgs::GenerateTrajectory::Request &req,
+    mmuav_msgs::GenerateTrajectory::Response &res)
+{
+    res.success = generate(req.keyframes, req.replan_from_segment,
+        req.sampling_frequency > 0.0 ? req.sampling_frequency : rate,
+        res.trajectory, res.message);
+    return true;
+}
+
+void TrajectoryGeneration::keyframesCallback(const trajectory_msgs::MultiDOFJointTrajectory &msg)
+{
+    trajectory_msgs::MultiDOFJointTrajectory trajectory;
+    std::string message;
+    if (generate(msg, 0, rate, trajectory, message)) trajectoryPub.publish(trajectory);
+    else ROS_WARN("Trajectory generation failed: %s", message.c_str());
+}
+
+bool TrajectoryGeneration::generate(const trajectory_msgs::MultiDOFJointTrajectory &keyframes,
+    int replanFromSegment, double samplingFrequency,
+    trajectory_msgs::MultiDOFJointTrajectory &trajectory, std::string &message)
+{
+    int count = keyframes.points.size();
+    if (count < 2)
+    {
+        message = "at least two keyframes are needed";
+        return false;
+    }
+    if (replanFromSegment > lastTrajectory.segmentCount())
+    {
+        message = "replan_from_segment is past the end of the last trajectory";
+        return false;
+    }
+
+    TrajectoryMatrix points(count, 4);
+    for (int i = 0; i < count; i++)
+    {
+        if (keyframes.points[i].transforms.empty())
+        {
+            message = "keyframe without a transform";
+            return false;
+        }
+        const geometry_msgs::Transform &transform = keyframes.points[i].transforms[0];
+        const geometry_msgs::Quaternion &q = transform.rotation;
+        points(i, 0) = transform.translation.x;
+        points(i, 1) = transform.translation.y;
+        points(i, 2) = transform.translation.z;
+        points(i, 3) = atan2(2.0 * (q.w * q.z + q.x * q.y), 1.0 - 2.0 * (q.y * q.y + q.z * q.z));
+    }
+
+    ros::WallTime start = ros::WallTime::now();
+    PolynomialTrajectory polynomial;
+    bool planned = replanFromSegment > 0 ?
+        generator->replanTail(lastTrajectory, replanFromSegment, points,
+            segmentDurations(keyframes, points), polynomial) :
+        generator->generate(points, segmentDurations(keyframes, points), polynomial);
+    if (!planned)
+    {
+        message = "solving for the polynomial coefficients failed";
+        return false;
+    }
+    lastTrajectory = polynomial;
+    ROS_DEBUG("Planned %d segments in %.3f ms, %d cached structures.",
+        polynomial.segmentCount(), (ros::WallTime::now() - start).toSec() * 1e3,
+        (int)generator->cacheSize());
+
+    trajectory.header.stamp = ros::Time::now();
+    trajectory.header.frame_id = keyframes.header.frame_id;
+    trajectory.joint_names = keyframes.joint_names;
+    toMessage(polynomial, samplingFrequency, trajectory);
+    return true;
+}
+
+std::vector<double> TrajectoryGeneration::segmentDurations(
+    const trajectory_msgs::MultiDOFJointTrajectory &keyframes,
+    const TrajectoryMatrix &points) const
+{
+    // Keyframe times are used only if all of them are given.
+    std::vector<double> durations;
+    for (size_t i = 1; i < keyframes.points.size(); i++)
+    {
+        double duration = (keyframes.points[i].time_from_start -
+            keyframes.points[i - 1].time_from_start).toSec();
+        if (duration <= 0.0)
+            return MinSnapTrajectoryGenerator::estimateDurations(points, maxVelocity,
+                maxYawRate, minSegmentDuration);
+        durations.push_back(duration);
+    }
+    return durations;
+}
+
+void TrajectoryGeneration::toMessage(const PolynomialTrajectory &polynomial,
+    double samplingFrequency, trajectory_msgs::MultiDOFJointTrajectory &trajectory) const
+{
+    std::vector<double> times;
+    TrajectoryMatrix position, velocity, acceleration;
+    polynomial.sample(1.0 / samplingFrequency, times, position, velocity, acceleration);
+
+    trajectory.points.resize(times.size());
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        trajectory_msgs::MultiDOFJointTrajectoryPoint &point = trajectory.points[i];
+        point.transforms.resize(1);
+        point.velocities.resize(1);
+        point.accelerations.resize(1);
+
+        geometry_msgs::Transform &transform = point.transforms[0];
+        transform.translation.x = position(i, 0);
+        transform.translation.y = position(i, 1);
+        transform.translation.z = position(i, 2);
+        transform.rotation.x = 0.0;
+        transform.rotation.y = 0.0;
+        transform.rotation.z = sin(position(i, 3) / 2.0);
+        transform.rotation.w = cos(position(i, 3) / 2.0);
+
+        point.velocities[0].linear.x = velocity(i, 0);
+        point.velocities[0].linear.y = velocity(i, 1);
+        point.velocities[0].linear.z = velocity(i, 2);
+        point.velocities[0].angular.z = velocity(i, 3);
+
+        point.accelerations[0].linear.x = acceleration(i, 0);
+        point.accelerations[0].linear.y = acceleration(i, 1);
+        point.accelerations[0].linear.z = acceleration(i, 2);
+        point.accelerations[0].angular.z = acceleration(i, 3);
+
+        point.time_from_start = ros::Duration(times[i]);
+    }
+}
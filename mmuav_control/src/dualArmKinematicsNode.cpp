@@ -0,0 +1,14 @@
+/******************************************************************************
+File name: dualArmKinematicsNode.cpp
+Description: Batched dual arm inverse kinematics node
+******************************************************************************/
+
+#include <mmuav_control/DualArmKinematicsServer.h>
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "dual_arm_kinematics");
+    DualArmKinematicsServer server;
+    server.run();
+    return 0;
+}
@@ -0,0 +1,14 @@
+/******************************************************************************
+File name: trajectoryGenerationNode.cpp
+Description: Minimum snap trajectory generation node
+******************************************************************************/
+
+#include <mmuav_control/TrajectoryGeneration.h>
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "trajectory_generation");
+    TrajectoryGeneration trajectoryGeneration;
+    trajectoryGeneration.run();
+    return 0;
+}
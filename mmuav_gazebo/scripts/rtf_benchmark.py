@@ -0,0 +1,282 @@
+#!/usr/bin/env python
+
+"""
+Real-time factor benchmark of all vehicle variants.
+
+Every variant from config/rtf_benchmark.yaml is launched headless in its own
+roslaunch (and therefore its own master), runs for a fixed amount of sim time
+while the scripted commands are published, and is then shut down. Before the
+run the real time throttle of gazebo is switched off (real_time_update_rate
+0 through /gazebo/set_physics_properties), so the world steps as fast as the
+CPU allows and the numbers below reflect the cost of a step instead of the
+throttle. For each variant the following is recorded:
+    rtf                 - sim time / wall time over the scripted run, unthrottled
+    wall_per_step_us    - wall time per physics step, unthrottled
+    startup_s           - roslaunch start until the model is spawned
+    peak_rss_mb         - peak resident set size of gzserver
+
+Results are written as json. The run fails (exit code 1) if a value crosses
+its threshold from the config, or if --baseline is given and a value is worse
+than the baseline by more than --tolerance.
+
+Usage:
+    rosrun mmuav_gazebo rtf_benchmark.py --output results.json
+    rosrun mmuav_gazebo rtf_benchmark.py --variants uav,dfcuav --baseline old.json
+"""
+
+__author__ = 'mmuav'
+
+import argparse
+import json
+import os
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+import yaml
+
+# Metrics where a larger value is better, all others are better when smaller.
+HIGHER_IS_BETTER = ['rtf']
+THRESHOLDS = {
+    'min_rtf': ('rtf', lambda value, limit: value >= limit),
+    'max_wall_per_step_us': ('wall_per_step_us', lambda value, limit: value <= limit),
+    'max_startup_s': ('startup_s', lambda value, limit: value <= limit),
+    'max_peak_rss_mb': ('peak_rss_mb', lambda value, limit: value <= limit),
+}
+
+
+def find_gzserver(process_group):
+    '''
+    Returns pid of the gzserver started in the given process group, or None.
+    '''
+    for entry in os.listdir('/proc'):
+        if not entry.isdigit():
+            continue
+        try:
+            with open('/proc/%s/cmdline' % entry) as f:
+                cmdline = f.read()
+            if 'gzserver' in cmdline and os.getpgid(int(entry)) == process_group:
+                return int(entry)
+        except (IOError, OSError):
+            continue
+    return None
+
+
+def peak_rss_mb(pid):
+    '''
+    Peak resident set size (VmHWM) of a process in MB.
+    '''
+    with open('/proc/%d/status' % pid) as f:
+        for line in f:
+            if line.startswith('VmHWM:'):
+                return float(line.split()[1]) / 1024.0
+    return None
+
+
+def run_variant(variant, config, log_dir):
+    '''
+    Launches one variant and measures it. Runs in a child process, since
+    rospy can only be initialized once and every variant has its own master.
+    '''
+    import rosgraph
+    import rospy
+    import roslib.message
+    import genpy.message
+    from gazebo_msgs.msg import ModelStates
+    from gazebo_msgs.srv import GetPhysicsProperties, SetPhysicsProperties
+    from rosgraph_msgs.msg import Clock
+
+    startup_timeout = config.get('startup_timeout', 120.0)
+    sim_duration = config.get('sim_duration', 30.0)
+
+    log = open(os.path.join(log_dir, variant['name'] + '.log'), 'w')
+    start = time.time()
+    launch = subprocess.Popen(['roslaunch', 'mmuav_gazebo', variant['launch'],
+        'gui:=false', 'headless:=true', 'paused:=false'] + variant.get('args', []),
+        stdout=log, stderr=subprocess.STDOUT, preexec_fn=os.setsid)
+
+    state = {'sim_time': None, 'spawned': False}
+
+    def clock_cb(msg):
+        state['sim_time'] = msg.clock.to_sec()
+
+    def model_states_cb(msg):
+        if variant['model'] in msg.name:
+            state['spawned'] = True
+
+    try:
+        master = rosgraph.Master('/rtf_benchmark')
+        while not master.is_online():
+            if time.time() - start > startup_timeout:
+                raise RuntimeError('master did not start')
+            time.sleep(0.1)
+
+        rospy.init_node('rtf_benchmark', anonymous=True, disable_signals=True)
+        rospy.Subscriber('/clock', Clock, clock_cb, queue_size=1)
+        rospy.Subscriber('/gazebo/model_states', ModelStates, model_states_cb, queue_size=1)
+
+        while not state['spawned'] or state['sim_time'] is None:
+            if time.time() - start > startup_timeout:
+                raise RuntimeError('model %s was not spawned' % variant['model'])
+            time.sleep(0.05)
+        startup_s = time.time() - start
+
+        rospy.wait_for_service('/gazebo/get_physics_properties', startup_timeout)
+        physics = rospy.ServiceProxy('/gazebo/get_physics_properties', GetPhysicsProperties)()
+        time_step = physics.time_step
+
+        # With the default real_time_update_rate of 1000 and a 1 ms step the
+        # world never runs faster than real time, which hides any headroom.
+        # Keep everything else of the world as it is.
+        rospy.wait_for_service('/gazebo/set_physics_properties', startup_timeout)
+        response = rospy.ServiceProxy('/gazebo/set_physics_properties', SetPhysicsProperties)(
+            time_step=physics.time_step, max_update_rate=0.0, gravity=physics.gravity,
+            ode_config=physics.ode_config)
+        if not response.success:
+            raise RuntimeError('could not switch off the real time throttle: %s' % response.status_message)
+
+        # Latched, so commands are not lost if a controller subscribes late.
+        commands = []
+        for command in sorted(variant.get('commands', []), key=lambda c: c['time']):
+            msg = roslib.message.get_message_class(command['type'])()
+            genpy.message.fill_message_args(msg, [command['data']])
+            publisher = rospy.Publisher(command['topic'],
+                type(msg), queue_size=1, latch=True)
+            commands.append((command['time'], publisher, msg))
+
+        wall_start = time.time()
+        sim_start = state['sim_time']
+        run_timeout = config.get('run_timeout', 20.0 * sim_duration + 60.0)
+        while state['sim_time'] - sim_start < sim_duration:
+            elapsed = state['sim_time'] - sim_start
+            while commands and commands[0][0] <= elapsed:
+                command_time, publisher, msg = commands.pop(0)
+                publisher.publish(msg)
+            if time.time() - wall_start > run_timeout:
+                raise RuntimeError('run did not finish in %.0f s' % run_timeout)
+            time.sleep(0.005)
+        wall = time.time() - wall_start
+        sim = state['sim_time'] - sim_start
+
+        gzserver = find_gzserver(launch.pid)
+        result = {
+            'rtf': sim / wall,
+            'wall_per_step_us': wall * 1e6 / (sim / time_step),
+            'startup_s': startup_s,
+            'peak_rss_mb': peak_rss_mb(gzserver) if gzserver else None,
+            'sim_time_s': sim,
+            'wall_time_s': wall,
+            'time_step': time_step,
+        }
+    finally:
+        try:
+            os.killpg(launch.pid, signal.SIGINT)
+            for i in range(200):
+                if launch.poll() is not None:
+                    break
+                time.sleep(0.1)
+            else:
+                os.killpg(launch.pid, signal.SIGKILL)
+        except OSError:
+            pass
+        log.close()
+
+    return result
+
+
+def check(metrics, thresholds, baseline, tolerance):
+    '''
+    Returns list of failure descriptions for one variant.
+    '''
+    failures = []
+    for key, (metric, passes) in THRESHOLDS.items():
+        if key not in thresholds or metrics.get(metric) is None:
+            continue
+        if not passes(metrics[metric], thresholds[key]):
+            failures.append('%s %.3f violates %s %.3f' % (metric, metrics[metric], key, thresholds[key]))
+
+    if baseline is None:
+        return failures
+    for metric, reference in baseline.items():
+        value = metrics.get(metric)
+        if value is None or reference is None or metric not in [m for m, p in THRESHOLDS.values()]:
+            continue
+        if metric in HIGHER_IS_BETTER:
+            regressed = value < reference * (1.0 - tolerance)
+        else:
+            regressed = value > reference * (1.0 + tolerance)
+        if regressed:
+            failures.append('%s %.3f regressed from baseline %.3f' % (metric, value, reference))
+    return failures
+
+
+def main():
+    default_config = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+        '..', 'config', 'rtf_benchmark.yaml')
+    parser = argparse.ArgumentParser(description='Real-time factor benchmark of the vehicle variants.')
+    parser.add_argument('--config', default=default_config)
+    parser.add_argument('--variants', default='', help='comma separated subset of variants')
+    parser.add_argument('--output', default='rtf_benchmark.json')
+    parser.add_argument('--baseline', default='', help='results of an earlier run to compare against')
+    parser.add_argument('--tolerance', type=float, default=0.1, help='allowed relative regression')
+    parser.add_argument('--run-variant', default='', help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    with open(args.config) as f:
+        config = yaml.safe_load(f)
+
+    if args.run_variant:
+        # Child process, measure a single variant and print the result.
+        variant = json.loads(args.run_variant)
+        print(json.dumps(run_variant(variant, config, os.path.dirname(args.output))))
+        return 0
+
+    selected = [v for v in args.variants.split(',') if v]
+    variants = [v for v in config['variants'] if not selected or v['name'] in selected]
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = dict((v['name'], v['metrics']) for v in json.load(f)['variants'])
+
+    log_dir = tempfile.mkdtemp(prefix='rtf_benchmark_')
+    results = []
+    for variant in variants:
+        print('Benchmarking %s (%s)' % (variant['name'], variant['launch']))
+        thresholds = dict(config.get('default_thresholds', {}))
+        thresholds.update(variant.get('thresholds', {}))
+
+        child = subprocess.Popen([sys.executable, os.path.abspath(__file__),
+            '--config', args.config, '--output', os.path.join(log_dir, 'result'),
+            '--run-variant', json.dumps(variant)], stdout=subprocess.PIPE)
+        output = child.communicate()[0]
+        if child.returncode != 0:
+            metrics = {}
+            failures = ['benchmark run failed, see %s' % os.path.join(log_dir, variant['name'] + '.log')]
+        else:
+            metrics = json.loads(output.decode().strip().splitlines()[-1])
+            failures = check(metrics, thresholds,
+                baseline.get(variant['name']), args.tolerance)
+
+        for failure in failures:
+            print('  FAIL %s' % failure)
+        if metrics:
+            print('  rtf %.3f, %.1f us/step, startup %.1f s, peak rss %s MB' % (metrics['rtf'],
+                metrics['wall_per_step_us'], metrics['startup_s'], metrics['peak_rss_mb']))
+        results.append({'name': variant['name'], 'launch': variant['launch'],
+            'metrics': metrics, 'thresholds': thresholds, 'failures': failures})
+
+    passed = all(not r['failures'] for r in results)
+    with open(args.output, 'w') as f:
+        json.dump({'timestamp': time.time(), 'host': socket.gethostname(),
+            'sim_duration': config.get('sim_duration', 30.0), 'passed': passed,
+            'variants': results}, f, indent=2, sort_keys=True)
+    print('Results written to %s, logs in %s' % (args.output, log_dir))
+    return 0 if passed else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -98,6 +98,8 @@ discretized system (ZoH):
       return outputState;
 
     }
+    T getState() const { return previousState_; }
+    void setState(T state) { previousState_ = state; }
     ~FirstOrderFilter() {}
 
   protected:
@@ -0,0 +1,117 @@
+#ifndef MMUAV_PLUGINS_FIDELITY_SCHEDULER_H
+#define MMUAV_PLUGINS_FIDELITY_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <gazebo/common/common.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo {
+
+/// \brief Detail of the rotor aerodynamics, from the most to the least expensive.
+enum class FidelityLevel : int {
+  /// Flap aerodynamics, rotor drag, rolling moment and the motor dynamics.
+  Full = 0,
+  /// Thrust and yaw torque of the filtered rotor velocity.
+  Reduced = 1,
+  /// Thrust and yaw torque computed once per command, no motor dynamics.
+  Minimal = 2
+};
+
+const char* FidelityLevelName(FidelityLevel level);
+/// \return false if name is not "full", "reduced" or "minimal".
+bool ParseFidelityLevel(const std::string& name, FidelityLevel& level);
+
+// Default values
+static constexpr double kDefaultFidelityTargetRealTimeFactor = 1.0;
+static constexpr double kDefaultFidelityDegradeRealTimeFactor = 0.95;
+static constexpr double kDefaultFidelityUpgradeLoad = 0.6;
+static constexpr double kDefaultFidelityWindow = 1.0;
+static constexpr double kDefaultFidelitySwitchInterval = 2.0;
+
+/// \brief Thresholds of the scheduler, all times are wall clock seconds.
+struct FidelitySchedulerParams {
+  /// Real time factor the world is expected to run at.
+  double target_real_time_factor = kDefaultFidelityTargetRealTimeFactor;
+  /// A vehicle is degraded while the real time factor is below this fraction of the target.
+  double degrade_real_time_factor = kDefaultFidelityDegradeRealTimeFactor;
+  /// A vehicle is upgraded while the step cost is below this fraction of the step budget.
+  double upgrade_load = kDefaultFidelityUpgradeLoad;
+  /// Length of the measurement window.
+  double window = kDefaultFidelityWindow;
+  /// Minimum time between two switches.
+  double switch_interval = kDefaultFidelitySwitchInterval;
+};
+
+/// \brief Level of one vehicle, shared by all of its rotor plugins.
+struct FidelityVehicle {
+  std::string name;
+  /// Vehicles with a higher priority are degraded last and upgraded first.
+  int priority;
+  /// Written by the scheduler, read by the rotor plugins on the physics thread.
+  std::atomic<int> level;
+};
+
+/**
+ * \brief Switches vehicles between fidelity levels to keep a world real time.
+ *
+ * One scheduler per world measures the wall time of every world update (the
+ * step cost) and the real time factor over a window. While the real time
+ * factor stays below degrade_real_time_factor of the target, the vehicle with
+ * the lowest priority that still has a level to give is degraded by one
+ * level. While the step cost is below upgrade_load of the step budget (the
+ * physics step over the target real time factor), the vehicle with the
+ * highest priority that is degraded gets one level back. The gap between the
+ * two conditions and the switch interval keep a vehicle from toggling. Every
+ * switch is logged with the measurements it was based on.
+ */
+class FidelityScheduler {
+ public:
+  static std::shared_ptr<FidelityScheduler> Get(physics::WorldPtr world);
+  ~FidelityScheduler();
+
+  /// \brief The first call sets the thresholds of the world, later ones are ignored
+  /// with a warning if they differ.
+  void Configure(const FidelitySchedulerParams& params);
+  /// \brief Returns the entry of the vehicle, rotors of the same vehicle share one.
+  /// The first rotor of a vehicle sets its starting level.
+  std::shared_ptr<FidelityVehicle> Register(const std::string& vehicle, int priority, FidelityLevel level);
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit FidelityScheduler(physics::WorldPtr world);
+
+  void OnUpdateBegin(const common::UpdateInfo& _info);
+  void OnUpdateEnd();
+  void Evaluate(double real_time_factor, double load);
+  void Switch(FidelityVehicle& vehicle, FidelityLevel level, double real_time_factor, double load);
+
+  physics::WorldPtr world_;
+  event::ConnectionPtr update_begin_connection_;
+  event::ConnectionPtr update_end_connection_;
+
+  std::mutex mutex_;
+  bool configured_;
+  FidelitySchedulerParams params_;
+  std::vector<std::weak_ptr<FidelityVehicle>> vehicles_;
+
+  Clock::time_point step_begin_;
+  Clock::time_point window_begin_;
+  Clock::time_point last_switch_;
+  double window_sim_begin_;
+  double window_step_cost_;
+  int window_steps_;
+  bool window_started_;
+};
+
+}
+
+#endif // MMUAV_PLUGINS_FIDELITY_SCHEDULER_H
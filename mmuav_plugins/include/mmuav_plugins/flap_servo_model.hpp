@@ -0,0 +1,76 @@
+#ifndef MMUAV_PLUGINS_FLAP_SERVO_MODEL_H
+#define MMUAV_PLUGINS_FLAP_SERVO_MODEL_H
+
+#include <algorithm>
+#include <cmath>
+
+class FlapServoModel
+{
+/*
+Simple model of the servo driving a ducted fan control flap. It is meant to be
+integrated inside the motor plugin, so the flap angle does not have to go
+through an external joint controller on every step.
+
+The reference passes through the following stages:
+    saturation  -> the reference is clipped to [-maxAngle, maxAngle]
+    bandwidth   -> first order lag with cutoff frequency bandwidth [Hz]
+    rate limit  -> servo shaft velocity is limited to maxRate [rad/s]
+    backlash    -> the flap follows the shaft only after the gap is closed
+
+Setting bandwidth, maxRate or backlash to zero (or less) disables that stage.
+*/
+
+  public:
+    FlapServoModel(double bandwidth, double maxRate, double backlash,
+                   double maxAngle, double initialAngle = 0.0):
+      bandwidth_(bandwidth),
+      maxRate_(maxRate),
+      backlash_(backlash),
+      maxAngle_(maxAngle),
+      shaftAngle_(initialAngle),
+      flapAngle_(initialAngle) {}
+
+    double update(double reference, double samplingTime) {
+      double target = std::max(-maxAngle_, std::min(reference, maxAngle_));
+
+      if (bandwidth_ > 0.0) {
+        double alpha = exp(-samplingTime * 2.0 * M_PI * bandwidth_);
+        target = alpha * shaftAngle_ + (1 - alpha) * target;
+      }
+
+      double step = target - shaftAngle_;
+      if (maxRate_ > 0.0) {
+        double maxStep = maxRate_ * samplingTime;
+        step = std::max(-maxStep, std::min(step, maxStep));
+      }
+      shaftAngle_ += step;
+
+      // The flap is dragged along only when the shaft reaches one side of the gap.
+      double halfGap = 0.5 * std::max(backlash_, 0.0);
+      if (shaftAngle_ - flapAngle_ > halfGap)
+        flapAngle_ = shaftAngle_ - halfGap;
+      else if (shaftAngle_ - flapAngle_ < -halfGap)
+        flapAngle_ = shaftAngle_ + halfGap;
+
+      flapAngle_ = std::max(-maxAngle_, std::min(flapAngle_, maxAngle_));
+      return flapAngle_;
+    }
+
+    double getFlapAngle() const { return flapAngle_; }
+    double getShaftAngle() const { return shaftAngle_; }
+    void setState(double shaftAngle, double flapAngle) {
+      shaftAngle_ = shaftAngle;
+      flapAngle_ = flapAngle;
+    }
+    ~FlapServoModel() {}
+
+  protected:
+    double bandwidth_;
+    double maxRate_;
+    double backlash_;
+    double maxAngle_;
+    double shaftAngle_;
+    double flapAngle_;
+};
+
+#endif // MMUAV_PLUGINS_FLAP_SERVO_MODEL_H
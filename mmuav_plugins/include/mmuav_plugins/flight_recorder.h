@@ -0,0 +1,73 @@
+#ifndef MMUAV_PLUGINS_FLIGHT_RECORDER_H
+#define MMUAV_PLUGINS_FLIGHT_RECORDER_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+namespace gazebo {
+
+static const char kFlightRecorderMagic[8] = {'M', 'M', 'U', 'A', 'V', 'F', 'R', '1'};
+static constexpr uint32_t kFlightRecorderVersion = 1;
+static constexpr uint64_t kDefaultFlightRecorderCapacity = 1 << 20;
+
+/// \brief Fixed layout header at the start of the recorder file.
+struct FlightRecorderHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+  /// Total number of records ever written, the ring index is write_count % capacity.
+  uint64_t write_count;
+};
+
+/// \brief One rotor sample for one physics step. All vectors are [x, y, z].
+struct FlightRecord {
+  double sim_time;
+  int32_t motor_number;
+  int32_t reserved;
+  double rotor_velocity;
+  double flap_angle;
+  double force[3];
+  double moment[3];
+  double drag[3];
+  double rolling_moment[3];
+};
+
+/**
+ * \brief Memory mapped ring buffer of FlightRecords.
+ *
+ * All rotors that open the same path share one recorder, so a whole vehicle
+ * ends up in a single file. Write() only copies the record into the mapping,
+ * it never allocates, formats or makes a system call, which keeps it cheap
+ * enough to run on the physics thread at full rate. Use
+ * flight_recorder_export to convert the file to csv.
+ */
+class FlightRecorder {
+ public:
+  /// \brief Opens (and resets) the recorder file, or returns the already open one.
+  /// \return nullptr if the file could not be created or mapped, errno is set.
+  static std::shared_ptr<FlightRecorder> Open(const std::string& path, uint64_t capacity);
+
+  ~FlightRecorder();
+
+  void Write(const FlightRecord& record);
+
+  const std::string& path() const { return path_; }
+  uint64_t capacity() const { return header_->capacity; }
+
+ private:
+  FlightRecorder(const std::string& path, int fd, void* map, size_t map_size);
+
+  std::string path_;
+  int fd_;
+  void* map_;
+  size_t map_size_;
+  FlightRecorderHeader* header_;
+  FlightRecord* records_;
+};
+
+}
+
+#endif // MMUAV_PLUGINS_FLIGHT_RECORDER_H
@@ -0,0 +1,125 @@
+#ifndef MMUAV_PLUGINS_GAZEBO_DIPOLE_MAGNET_H
+#define MMUAV_PLUGINS_GAZEBO_DIPOLE_MAGNET_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <geometry_msgs/WrenchStamped.h>
+#include <ros/ros.h>
+#include <std_msgs/Float64.h>
+
+#include "common.h"
+
+namespace gazebo {
+// Default values
+static constexpr double kDefaultMagnetCutoffDistance = 1.0;
+static constexpr double kDefaultMagnetMinDistance = 0.01;
+static constexpr double kDefaultMagnetUpdateRate = 100.0;
+// mu_0 / (4 * pi)
+static constexpr double kMagneticConstantOver4Pi = 1e-7;
+
+/// \brief State of one magnet, shared between its plugin and the world registry.
+struct DipoleMagnet {
+  physics::LinkPtr link;
+  ignition::math::Vector3d moment_body;
+  /// Written from the ROS callback thread, read on the physics thread.
+  std::atomic<double> gain;
+
+  // Filled by the registry on every step.
+  ignition::math::Vector3d position_world;
+  ignition::math::Vector3d moment_world;
+  ignition::math::Vector3d force_world;
+  ignition::math::Vector3d torque_world;
+};
+
+/**
+ * \brief All magnets of one world.
+ *
+ * The registry owns the only update connection. On every step it bins the
+ * magnets into a spatial hash with cells of the cutoff distance, evaluates
+ * each pair closer than the cutoff once and applies the dipole force and
+ * torque to both links. Pairs further apart are never looked at, so the cost
+ * grows with the number of close magnets instead of the square of all
+ * magnets. The hash is a sorted array of cell keys, which is rebuilt in place
+ * and does not allocate once it has grown to the number of magnets.
+ */
+class DipoleMagnetRegistry {
+ public:
+  static std::shared_ptr<DipoleMagnetRegistry> Get(physics::WorldPtr world);
+  ~DipoleMagnetRegistry();
+
+  void Add(DipoleMagnet* magnet, double cutoff_distance, double min_distance);
+  void Remove(DipoleMagnet* magnet);
+
+ private:
+  explicit DipoleMagnetRegistry(physics::WorldPtr world);
+
+  void OnUpdate(const common::UpdateInfo& _info);
+  int64_t CellKey(int x, int y, int z) const;
+  void CellOf(const ignition::math::Vector3d& position, int& x, int& y, int& z) const;
+  void ApplyPair(DipoleMagnet& a, DipoleMagnet& b) const;
+
+  physics::WorldPtr world_;
+  event::ConnectionPtr updateConnection_;
+
+  std::mutex mutex_;
+  std::vector<DipoleMagnet*> magnets_;
+  double cutoff_distance_;
+  double min_distance_;
+  std::vector<std::pair<int64_t, int>> cells_;
+};
+
+class GazeboDipoleMagnet : public ModelPlugin {
+ public:
+  GazeboDipoleMagnet()
+      : ModelPlugin(),
+        cutoff_distance_(kDefaultMagnetCutoffDistance),
+        min_distance_(kDefaultMagnetMinDistance),
+        update_rate_(kDefaultMagnetUpdateRate),
+        should_publish_(false),
+        prev_publish_time_(0.0),
+        node_handle_(nullptr) {}
+
+  virtual ~GazeboDipoleMagnet();
+
+ protected:
+  virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+  virtual void OnUpdate(const common::UpdateInfo & /*_info*/);
+
+ private:
+  void GainCallback(const std_msgs::Float64ConstPtr& msg);
+
+  std::string namespace_;
+  std::string body_name_;
+  std::string topic_ns_;
+
+  double cutoff_distance_;
+  double min_distance_;
+  double update_rate_;
+  bool should_publish_;
+  double prev_publish_time_;
+
+  DipoleMagnet magnet_;
+  std::shared_ptr<DipoleMagnetRegistry> registry_;
+
+  ros::NodeHandle* node_handle_;
+  ros::Subscriber gain_sub_;
+  ros::Publisher wrench_pub_;
+  geometry_msgs::WrenchStamped wrench_msg_;
+
+  physics::ModelPtr model_;
+  /// \brief Pointer to the update event connection.
+  event::ConnectionPtr updateConnection_;
+};
+}
+
+#endif // MMUAV_PLUGINS_GAZEBO_DIPOLE_MAGNET_H
@@ -19,33 +19,53 @@
 #include <rotors_comm/WindSpeed.h>
 #include <std_msgs/Float32.h>
 #include <std_msgs/Float64.h>
+#include <std_msgs/Float64MultiArray.h>
 #include <control_msgs/JointControllerState.h>
+#include <mmuav_control/MixerEngine.h>
 
 #include "common.h"
+#include "fidelity_scheduler.h"
+#include "flap_servo_model.hpp"
+#include "flight_recorder.h"
 #include "motor_model.hpp"
-
-namespace turning_direction {
-const static int CCW = 1;
-const static int CW = -1;
-}
+#include "motor_model_defaults.h"
+#include "scenario_snapshot.h"
 
 namespace gazebo {
 // Default values
-static const std::string kDefaultCommandSubTopic = "gazebo/command/motor_speed";
-static const std::string kDefaultWindSpeedSubTopic = "gazebo/wind_speed";
 static const std::string kDefaultAngleflapSubTopic = "mmuav/angle";
+static const std::string kDefaultMixerThrustSubTopic = "mot_vel_ref";
+static const std::string kDefaultMixerAttitudeSubTopic = "attitude_command";
+// attitude_command layout of the vpc_* attitude controllers, the only ones
+// flying ducted fans (vpc_dfc_attitude_control.py).
+static const std::string kDefaultMixerAttitudeInputs = "0 1 2 4 5";
+
+static constexpr double kDefaultFlapServoBandwidth = 10.0;
+static constexpr double kDefaultFlapServoMaxRate = 6.0;
+static constexpr double kDefaultFlapServoBacklash = 0.0;
+static constexpr double kDefaultFlapServoMaxAngle = 0.26179;
+static constexpr uint32_t kMotorModelSnapshotVersion = 1;
+
+/// \brief Per rotor constants of the ducted fan formulas, precomputed in Load().
+///
+/// With the slip velocity term s = w^2 * slipVelocityCoefficient and the control
+/// flap angle a, one step applies
+///   force  = flap_force * s * a + (0, 0, thrust - s * (drag_at0 + drag_flap * a^2))
+///   moment = flap_moment * s * a + (0, 0, yaw_moment * thrust)
+/// for any rotor, whatever its number or position in the airframe.
+struct DuctedFanRotorGeometry {
+  /// Flap axis scaled with fluid density, flap area and flap lift coefficient.
+  ignition::math::Vector3d flap_force;
+  /// flap_force times the flap lever arm.
+  ignition::math::Vector3d flap_moment;
+  /// Drag of both flaps at zero angle and the quadratic drag of the control flap.
+  double drag_at0;
+  double drag_flap;
+  /// Reaction torque per unit thrust, signed with the turning direction.
+  double yaw_moment;
+};
 
-// Set the max_force_ to the max double value. The limitations get handled by the FirstOrderFilter.
-static constexpr double kDefaultMaxForce = std::numeric_limits<double>::max();
-static constexpr double kDefaultMotorConstant = 8.54858e-06;
-static constexpr double kDefaultMomentConstant = 0.016;
-static constexpr double kDefaultTimeConstantUp = 1.0 / 80.0;
-static constexpr double kDefaultTimeConstantDown = 1.0 / 40.0;
-static constexpr double kDefaulMaxRotVelocity = 838.0;
-static constexpr double kDefaultRotorDragCoefficient = 1.0e-4;
-static constexpr double kDefaultRollingMomentCoefficient = 1.0e-6;
-
-class GazeboMotorModel : public MotorModel, public ModelPlugin {
+class GazeboMotorModel : public MotorModel, public ModelPlugin, public SnapshotParticipant {
  public:
   GazeboMotorModel()
       : ModelPlugin(),
@@ -66,6 +86,23 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
         rotor_velocity_slowdown_sim_(kDefaultRotorVelocitySlowdownSim),
         time_constant_down_(kDefaultTimeConstantDown),
         time_constant_up_(kDefaultTimeConstantUp),
+        angle_control_flap_(0.0),
+        angle_control_flap_ref_(0.0),
+        use_internal_flap_servo_(false),
+        flap_servo_bandwidth_(kDefaultFlapServoBandwidth),
+        flap_servo_max_rate_(kDefaultFlapServoMaxRate),
+        flap_servo_backlash_(kDefaultFlapServoBacklash),
+        flap_servo_max_angle_(kDefaultFlapServoMaxAngle),
+        flight_recorder_capacity_(kDefaultFlightRecorderCapacity),
+        kinematic_rotor_(false),
+        visual_rotor_spin_(true),
+        kinematic_rotor_velocity_(0.0),
+        mixer_thrust_sub_topic_(kDefaultMixerThrustSubTopic),
+        mixer_attitude_sub_topic_(kDefaultMixerAttitudeSubTopic),
+        mixer_thrust_received_(false),
+        mixer_attitude_received_(false),
+        fidelity_level_(FidelityLevel::Full),
+        minimal_command_(-1.0),
         node_handle_(nullptr),
         wind_speed_W_(0, 0, 0) {}
 
@@ -74,6 +111,9 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
   virtual void InitializeParams();
   virtual void Publish();
 
+  virtual void SaveSnapshot(std::ostream& out) const;
+  virtual bool RestoreSnapshot(std::istream& in);
+
  protected:
   virtual void UpdateForcesAndMoments();
   virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
@@ -86,6 +126,7 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
   std::string link_name_;
   std::string motor_speed_pub_topic_;
   std::string namespace_;
+  std::string snapshot_key_;
 
   std::string angle_control_flap_ref_sub_topic_;
   std::string angle_control_flap_command_pub_topic_;
@@ -93,8 +134,6 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
 
   int motor_number_;
   int turning_direction_;
-  int flag_x;
-  int flag_y;
 
   double max_force_;
   double max_rot_velocity_;
@@ -124,13 +163,43 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
   double lift_coefficient_antitorque_flap_at0_;
   double drag_coefficient_antitorque_flap_at0_;
   double angle_control_flap_;
-  double angle_antitorque_flap_;
   double angle_control_flap_ref_;
 
+  bool use_internal_flap_servo_;
+  double flap_servo_bandwidth_;
+  double flap_servo_max_rate_;
+  double flap_servo_backlash_;
+  double flap_servo_max_angle_;
+
+  std::string flight_recorder_file_;
+  int flight_recorder_capacity_;
+
+  bool kinematic_rotor_;
+  bool visual_rotor_spin_;
+  double kinematic_rotor_velocity_;
+
+  std::string mixer_file_;
+  std::string mixer_thrust_sub_topic_;
+  std::string mixer_attitude_sub_topic_;
+  std::vector<int> mixer_attitude_inputs_;
+  bool mixer_thrust_received_;
+  bool mixer_attitude_received_;
+
+  // Level used without the scheduler, with it the level of fidelity_vehicle_ is used.
+  FidelityLevel fidelity_level_;
+  std::shared_ptr<FidelityScheduler> fidelity_scheduler_;
+  std::shared_ptr<FidelityVehicle> fidelity_vehicle_;
+  // Wrench of the minimal level, recomputed when the command changes.
+  double minimal_command_;
+  ignition::math::Vector3d minimal_force_;
+  ignition::math::Vector3d minimal_torque_;
+
   ros::NodeHandle* node_handle_;
   ros::Publisher motor_velocity_pub_;
   ros::Subscriber command_sub_;
   ros::Subscriber wind_speed_sub_;
+  ros::Subscriber mixer_thrust_sub_;
+  ros::Subscriber mixer_attitude_sub_;
 
   ros::Subscriber angle_control_flap_ref_sub_;
   ros::Publisher angle_control_flap_command_pub_;
@@ -139,6 +208,7 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
   physics::ModelPtr model_;
   physics::JointPtr joint_;
   physics::LinkPtr link_;
+  physics::LinkPtr parent_link_;
   /// \brief Pointer to the update event connection.
   event::ConnectionPtr updateConnection_;
 
@@ -153,9 +223,26 @@ class GazeboMotorModel : public MotorModel, public ModelPlugin {
   void WindSpeedCallback(const rotors_comm::WindSpeedConstPtr& wind_speed);
   void AngleControlFlapRefCallback(const std_msgs::Float32Ptr& angle);
   void AngleControlFlapValueCallback(const control_msgs::JointControllerStatePtr& msg);
+  void MixerThrustCallback(const std_msgs::Float64ConstPtr& msg);
+  void MixerAttitudeCallback(const std_msgs::Float64MultiArrayConstPtr& msg);
+  void UpdateMixedVelocity();
+
+  void UpdateFullWrench(double real_motor_velocity);
+  void UpdateReducedWrench(double real_motor_velocity);
+  void UpdateMinimalWrench();
+  void WriteFlightRecord(double real_motor_velocity, const ignition::math::Vector3d& force,
+                         const ignition::math::Vector3d& moment, const ignition::math::Vector3d& drag,
+                         const ignition::math::Vector3d& rolling_moment);
 
 
   std::unique_ptr<FirstOrderFilter<double>> rotor_velocity_filter_;
+  std::unique_ptr<FlapServoModel> flap_servo_;
+  std::shared_ptr<FlightRecorder> flight_recorder_;
+  // Heap allocated, the fixed size Eigen members need an alignment the plugin does not have.
+  std::unique_ptr<MixerEngine> mixer_;
+  std::unique_ptr<MixerEngine::InputVector> mixer_input_;
+  FlightRecord flight_record_;
+  DuctedFanRotorGeometry geometry_;
   ignition::math::Vector3<double> wind_speed_W_;
 };
 }
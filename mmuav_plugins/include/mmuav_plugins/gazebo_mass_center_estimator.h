@@ -0,0 +1,135 @@
+#ifndef MMUAV_PLUGINS_GAZEBO_MASS_CENTER_ESTIMATOR_H
+#define MMUAV_PLUGINS_GAZEBO_MASS_CENTER_ESTIMATOR_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <Eigen/Dense>
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <geometry_msgs/InertiaStamped.h>
+#include <ros/ros.h>
+
+#include "common.h"
+#include "mass_properties_shm.h"
+#include "scenario_snapshot.h"
+
+namespace gazebo {
+// Default values
+static const std::string kDefaultMassCenterBaseLinkName = "base_link";
+static const std::string kDefaultMassCenterJointNames =
+    "stick_to_movable_mass_0 stick_to_movable_mass_1 stick_to_movable_mass_2 stick_to_movable_mass_3";
+static const std::string kDefaultMassCenterPubTopic = "mass_properties";
+static constexpr double kDefaultMassCenterUpdateRate = 100.0;
+static constexpr double kDefaultMassCenterJointTolerance = 1e-6;
+static constexpr int kDefaultMassCenterResyncInterval = 1000;
+
+static constexpr uint32_t kMassCenterSnapshotVersion = 1;
+
+/**
+ * \brief Centre of mass and inertia of a vehicle with moving masses or arms.
+ *
+ * The mass properties are kept as sums over all links in the base link
+ * frame: the mass, the first moment sum(m p) and the inertia about the base
+ * origin. Every step the plugin reads the positions of the joints in
+ * jointNames (the prismatic masses, the arm joints). Only the links below a
+ * joint that moved by more than jointTolerance are updated. The plugin
+ * removes their previous parallel axis contribution from the sums and adds
+ * the new one. The whole tree is summed again only every resyncInterval
+ * steps, to catch rounding drift and slow changes of the other joints.
+ *
+ * The result, with the inertia moved to the centre of mass, is published as
+ * geometry_msgs/InertiaStamped at updateRate. Co-located controllers can
+ * also read it every physics step from sharedMemoryFile (see
+ * MassPropertiesShm), without a ROS hop.
+ *
+ * The sums follow from the link poses, so a restored scenario snapshot only
+ * brings back the publish timing and sums the whole tree again on the next
+ * step.
+ */
+class GazeboMassCenterEstimator : public ModelPlugin, public SnapshotParticipant {
+ public:
+  GazeboMassCenterEstimator()
+      : ModelPlugin(),
+        base_link_name_(kDefaultMassCenterBaseLinkName),
+        pub_topic_(kDefaultMassCenterPubTopic),
+        update_rate_(kDefaultMassCenterUpdateRate),
+        joint_tolerance_(kDefaultMassCenterJointTolerance),
+        resync_interval_(kDefaultMassCenterResyncInterval),
+        steps_since_resync_(-1),
+        prev_publish_time_(0.0),
+        mass_(0.0),
+        node_handle_(nullptr) {}
+
+  virtual ~GazeboMassCenterEstimator();
+
+  virtual void SaveSnapshot(std::ostream& out) const;
+  virtual bool RestoreSnapshot(std::istream& in);
+
+ protected:
+  virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+  virtual void OnUpdate(const common::UpdateInfo & /*_info*/);
+
+ private:
+  struct LinkMass {
+    physics::LinkPtr link;
+    double mass;
+    // Inertia in the inertial frame of the link.
+    Eigen::Matrix3d moment_of_inertia;
+    // Contribution to the sums as of the last update.
+    Eigen::Vector3d first_moment;
+    Eigen::Matrix3d inertia;
+  };
+
+  struct MovingJoint {
+    physics::JointPtr joint;
+    double position;
+    // Indices in links_ of every link below the joint.
+    std::vector<int> links;
+  };
+
+  void Resync(const ignition::math::Pose3d& base_pose);
+  void UpdateContribution(LinkMass& link, const ignition::math::Pose3d& base_pose);
+  void ComputeProperties(double sim_time);
+  void Publish();
+
+  std::string namespace_;
+  std::string base_link_name_;
+  std::string pub_topic_;
+  std::string shared_memory_file_;
+  std::string snapshot_key_;
+
+  double update_rate_;
+  double joint_tolerance_;
+  int resync_interval_;
+  int steps_since_resync_;
+  double prev_publish_time_;
+
+  std::vector<LinkMass> links_;
+  std::vector<MovingJoint> joints_;
+  // Links updated in the current step, kept to avoid allocating on every step.
+  std::vector<char> dirty_;
+  std::vector<int> updated_;
+
+  double mass_;
+  Eigen::Vector3d first_moment_;
+  Eigen::Matrix3d inertia_;
+  MassProperties properties_;
+  std::unique_ptr<MassPropertiesShm> shared_memory_;
+
+  ros::NodeHandle* node_handle_;
+  ros::Publisher inertia_pub_;
+  geometry_msgs::InertiaStamped inertia_msg_;
+
+  physics::ModelPtr model_;
+  physics::LinkPtr base_link_;
+  /// \brief Pointer to the update event connection.
+  event::ConnectionPtr updateConnection_;
+};
+}
+
+#endif // MMUAV_PLUGINS_GAZEBO_MASS_CENTER_ESTIMATOR_H
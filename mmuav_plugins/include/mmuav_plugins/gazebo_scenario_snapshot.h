@@ -0,0 +1,89 @@
+#ifndef MMUAV_PLUGINS_GAZEBO_SCENARIO_SNAPSHOT_H
+#define MMUAV_PLUGINS_GAZEBO_SCENARIO_SNAPSHOT_H
+
+#include <condition_variable>
+#include <mutex>
+
+#include <boost/bind.hpp>
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <ros/ros.h>
+#include <std_srvs/Trigger.h>
+
+#include "common.h"
+#include "scenario_snapshot.h"
+
+namespace gazebo {
+// Default values
+static const std::string kDefaultSnapshotFile = "/tmp/mmuav_scenario.snapshot";
+static constexpr double kDefaultSnapshotTimeout = 5.0;
+
+/**
+ * \brief World plugin that saves and restores a mid-flight checkpoint.
+ *
+ * A snapshot holds the sim time, the world pose and velocities of every link
+ * of every non static model, and the internal state of all plugins in the
+ * SnapshotRegistry (the rotor plugins, the serial HIL link and the mass
+ * centre estimator). Requests arrive through the services <namespace>/save
+ * and <namespace>/restore and are executed at the end of a world update, so
+ * the plugins always see a consistent state on the next step. The file is
+ * taken from the <namespace>/file parameter at call time, which allows
+ * fanning out experiments from several checkpoints.
+ *
+ * Restoring sets the sim time back to the one in the snapshot. The rospy
+ * controllers in mmuav_control sleep on rospy.Rate, which raises
+ * ROSTimeMovedBackwardsException when /clock jumps back and ends the node.
+ * Their state isn't part of the snapshot either, so restart them after a
+ * restore to an earlier time.
+ */
+class GazeboScenarioSnapshot : public WorldPlugin {
+ public:
+  GazeboScenarioSnapshot()
+      : WorldPlugin(),
+        namespace_("scenario_snapshot"),
+        snapshot_file_(kDefaultSnapshotFile),
+        timeout_(kDefaultSnapshotTimeout),
+        pending_request_(kNone),
+        request_result_(false),
+        node_handle_(nullptr) {}
+
+  virtual ~GazeboScenarioSnapshot();
+
+ protected:
+  virtual void Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+  virtual void OnUpdateEnd();
+
+ private:
+  enum Request { kNone, kSave, kRestore };
+
+  bool SaveCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
+  bool RestoreCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
+  bool Execute(Request request, std::string& message);
+
+  bool Save(const std::string& path, std::string& message);
+  bool Restore(const std::string& path, std::string& message);
+
+  std::string namespace_;
+  std::string snapshot_file_;
+  double timeout_;
+
+  std::mutex request_mutex_;
+  std::condition_variable request_done_;
+  Request pending_request_;
+  std::string request_file_;
+  std::string request_message_;
+  bool request_result_;
+
+  ros::NodeHandle* node_handle_;
+  ros::ServiceServer save_service_;
+  ros::ServiceServer restore_service_;
+
+  physics::WorldPtr world_;
+  /// \brief Pointer to the update event connection.
+  event::ConnectionPtr updateConnection_;
+};
+}
+
+#endif // MMUAV_PLUGINS_GAZEBO_SCENARIO_SNAPSHOT_H
@@ -0,0 +1,131 @@
+#ifndef MMUAV_PLUGINS_GAZEBO_SERIAL_HIL_H
+#define MMUAV_PLUGINS_GAZEBO_SERIAL_HIL_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <ros/ros.h>
+#include <std_msgs/Float64MultiArray.h>
+
+#include "common.h"
+#include "scenario_snapshot.h"
+#include "serial_hil_link.h"
+
+namespace gazebo {
+// Default values
+static const std::string kDefaultSerialHilDevice = "/dev/ttyUSB0";
+static const std::string kDefaultSerialHilCommandSubTopic = "movable_mass_all/command";
+static const std::string kDefaultSerialHilReadbackPubTopic = "movable_mass_all/readback";
+static const std::string kDefaultSerialHilJointNames =
+    "stick_to_movable_mass_0 stick_to_movable_mass_1 stick_to_movable_mass_2 stick_to_movable_mass_3";
+static constexpr int kDefaultSerialHilBaudrate = 115200;
+static constexpr double kDefaultSerialHilUpdateRate = 100.0;
+static constexpr double kDefaultSerialHilReadbackTimeout = 0.0;
+// Same conversion and limit as GazeboToArducopterSerial::allMassCallback.
+static constexpr double kDefaultSerialHilMassScaler = 5066.0;
+static constexpr double kDefaultSerialHilMaxMassPosition = 0.07;
+// Gains of the movable_mass_*_position_controller in moving_mass_control.yaml.
+static constexpr double kDefaultSerialHilP = 175.0;
+static constexpr double kDefaultSerialHilI = 4.75;
+static constexpr double kDefaultSerialHilD = 0.0;
+static constexpr double kDefaultSerialHilIClamp = 0.08;
+
+static constexpr uint32_t kSerialHilSnapshotVersion = 1;
+
+/**
+ * \brief Hardware in the loop link to the arducopter stepper board.
+ *
+ * Replaces the GazeboToArducopterSerial hop for the moving masses. The mass
+ * command from movable_mass_all/command is written to the board at
+ * updateRate in sim time, from the physics thread, with the frame of the
+ * bridge (terminator 67). The board answers with the same frame layout and
+ * terminator 80 holding the actual mass positions in steps. The simulated
+ * masses follow that readback, until the first readback they follow the
+ * command. With readbackTimeout > 0 every step that sends a frame waits (in
+ * wall time) for the answer, so the simulation runs in lockstep with the
+ * board.
+ *
+ * The plugin drives the mass joints itself, the ros_control position
+ * controllers of the masses must not be loaded (serial_hil:=true of
+ * mmcuav_control.launch leaves them out). Setting device to "pty"
+ * opens a pseudo terminal instead, its name is printed and set as the
+ * serial_hil_device parameter for a board stand-in.
+ *
+ * A scenario snapshot keeps the commanded and target mass positions and the
+ * frame timing. The board itself can't be rewound: after a restore it gets
+ * the restored command with the next frame and the masses follow its
+ * readback again. The integrators of the joint PIDs start from zero.
+ */
+class GazeboSerialHil : public ModelPlugin, public SnapshotParticipant {
+ public:
+  GazeboSerialHil()
+      : ModelPlugin(),
+        device_(kDefaultSerialHilDevice),
+        command_sub_topic_(kDefaultSerialHilCommandSubTopic),
+        readback_pub_topic_(kDefaultSerialHilReadbackPubTopic),
+        baudrate_(kDefaultSerialHilBaudrate),
+        update_rate_(kDefaultSerialHilUpdateRate),
+        readback_timeout_(kDefaultSerialHilReadbackTimeout),
+        mass_scaler_(kDefaultSerialHilMassScaler),
+        max_mass_position_(kDefaultSerialHilMaxMassPosition),
+        readback_received_(false),
+        link_error_reported_(false),
+        prev_frame_time_(-1.0),
+        prev_sim_time_(0.0),
+        node_handle_(nullptr) {}
+
+  virtual ~GazeboSerialHil();
+
+  virtual void SaveSnapshot(std::ostream& out) const;
+  virtual bool RestoreSnapshot(std::istream& in);
+
+ protected:
+  virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+  virtual void OnUpdate(const common::UpdateInfo & /*_info*/);
+
+ private:
+  void CommandCallback(const std_msgs::Float64MultiArrayConstPtr& msg);
+  void ExchangeFrames();
+
+  std::string namespace_;
+  std::string device_;
+  std::string command_sub_topic_;
+  std::string readback_pub_topic_;
+  std::string snapshot_key_;
+
+  int baudrate_;
+  double update_rate_;
+  double readback_timeout_;
+  double mass_scaler_;
+  double max_mass_position_;
+  bool readback_received_;
+  bool link_error_reported_;
+  double prev_frame_time_;
+  double prev_sim_time_;
+
+  SerialHilLink link_;
+
+  mutable std::mutex command_mutex_;
+  double command_[kSerialFrameValues];
+  double target_[kSerialFrameValues];
+  std::vector<physics::JointPtr> joints_;
+  std::vector<common::PID> pids_;
+
+  ros::NodeHandle* node_handle_;
+  ros::Subscriber command_sub_;
+  ros::Publisher readback_pub_;
+  std_msgs::Float64MultiArray readback_msg_;
+
+  physics::ModelPtr model_;
+  /// \brief Pointer to the update event connection.
+  event::ConnectionPtr updateConnection_;
+};
+}
+
+#endif // MMUAV_PLUGINS_GAZEBO_SERIAL_HIL_H
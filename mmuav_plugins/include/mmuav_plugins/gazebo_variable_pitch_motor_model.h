@@ -0,0 +1,148 @@
+#ifndef MMUAV_PLUGINS_GAZEBO_VARIABLE_PITCH_MOTOR_MODEL_H
+#define MMUAV_PLUGINS_GAZEBO_VARIABLE_PITCH_MOTOR_MODEL_H
+
+#include <stdio.h>
+
+#include <boost/bind.hpp>
+#include <Eigen/Eigen>
+#include <gazebo/common/common.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <mav_msgs/Actuators.h>
+#include <mav_msgs/default_topics.h>
+#include <ros/ros.h>
+#include <rotors_comm/WindSpeed.h>
+#include <std_msgs/Float32.h>
+
+#include "common.h"
+#include "motor_model.hpp"
+#include "motor_model_defaults.h"
+#include "rotor_performance_table.h"
+#include "scenario_snapshot.h"
+
+namespace gazebo {
+// Default values
+static constexpr double kDefaultPitchTimeConstant = 0.02;
+static constexpr double kDefaultMinPitch = -0.2;
+static constexpr double kDefaultMaxPitch = 0.4;
+static constexpr double kDefaultPitch = 0.0;
+static constexpr int kDefaultPitchTableSize = 25;
+static constexpr int kDefaultOmegaTableSize = 31;
+static constexpr int kDefaultInflowTableSize = 21;
+static constexpr double kDefaultMaxInflowVelocity = 10.0;
+static constexpr uint32_t kVariablePitchSnapshotVersion = 1;
+
+/**
+ * \brief Rotor with variable collective pitch.
+ *
+ * Thrust and torque come from a RotorPerformanceTable over pitch x rotor
+ * velocity x axial inflow, so the step only does a trilinear lookup. The
+ * table is loaded from performanceTableFile if it exists, otherwise it is
+ * generated from the blade parameters at Load() and written to that file,
+ * so the next start (and every other rotor using the same file) skips the
+ * blade element/momentum solve.
+ *
+ * The pitch reference is taken from the angles field of the motor command
+ * (mav_msgs/Actuators), indexed by motorNumber. Until a command carries
+ * angles, and for commands without them, the rotor flies at defaultPitch,
+ * so velocity only controllers can use it as a fixed pitch rotor. With the
+ * default untwisted blade a pitch of zero gives no thrust.
+ */
+class GazeboVariablePitchMotorModel : public MotorModel, public ModelPlugin, public SnapshotParticipant {
+ public:
+  GazeboVariablePitchMotorModel()
+      : ModelPlugin(),
+        MotorModel(),
+        command_sub_topic_(kDefaultCommandSubTopic),
+        wind_speed_sub_topic_(kDefaultWindSpeedSubTopic),
+        motor_speed_pub_topic_(mav_msgs::default_topics::MOTOR_MEASUREMENT),
+        motor_number_(0),
+        turning_direction_(turning_direction::CW),
+        max_rot_velocity_(kDefaulMaxRotVelocity),
+        rolling_moment_coefficient_(kDefaultRollingMomentCoefficient),
+        rotor_drag_coefficient_(kDefaultRotorDragCoefficient),
+        rotor_velocity_slowdown_sim_(kDefaultRotorVelocitySlowdownSim),
+        time_constant_down_(kDefaultTimeConstantDown),
+        time_constant_up_(kDefaultTimeConstantUp),
+        pitch_time_constant_(kDefaultPitchTimeConstant),
+        min_pitch_(kDefaultMinPitch),
+        max_pitch_(kDefaultMaxPitch),
+        ref_pitch_(kDefaultPitch),
+        pitch_(kDefaultPitch),
+        max_inflow_velocity_(kDefaultMaxInflowVelocity),
+        pitch_table_size_(kDefaultPitchTableSize),
+        omega_table_size_(kDefaultOmegaTableSize),
+        inflow_table_size_(kDefaultInflowTableSize),
+        node_handle_(nullptr),
+        wind_speed_W_(0, 0, 0) {}
+
+  virtual ~GazeboVariablePitchMotorModel();
+
+  virtual void InitializeParams();
+  virtual void Publish();
+
+  virtual void SaveSnapshot(std::ostream& out) const;
+  virtual bool RestoreSnapshot(std::istream& in);
+
+ protected:
+  virtual void UpdateForcesAndMoments();
+  virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+  virtual void OnUpdate(const common::UpdateInfo & /*_info*/);
+
+ private:
+  std::string command_sub_topic_;
+  std::string wind_speed_sub_topic_;
+  std::string joint_name_;
+  std::string link_name_;
+  std::string motor_speed_pub_topic_;
+  std::string namespace_;
+  std::string performance_table_file_;
+  std::string snapshot_key_;
+
+  int motor_number_;
+  int turning_direction_;
+
+  double max_rot_velocity_;
+  double rolling_moment_coefficient_;
+  double rotor_drag_coefficient_;
+  double rotor_velocity_slowdown_sim_;
+  double time_constant_down_;
+  double time_constant_up_;
+
+  double pitch_time_constant_;
+  double min_pitch_;
+  double max_pitch_;
+  double ref_pitch_;
+  double pitch_;
+
+  double max_inflow_velocity_;
+  int pitch_table_size_;
+  int omega_table_size_;
+  int inflow_table_size_;
+
+  ros::NodeHandle* node_handle_;
+  ros::Publisher motor_velocity_pub_;
+  ros::Subscriber command_sub_;
+  ros::Subscriber wind_speed_sub_;
+
+  physics::ModelPtr model_;
+  physics::JointPtr joint_;
+  physics::LinkPtr link_;
+  physics::LinkPtr parent_link_;
+  /// \brief Pointer to the update event connection.
+  event::ConnectionPtr updateConnection_;
+
+  std_msgs::Float32 turning_velocity_msg_;
+
+  void VelocityCallback(const mav_msgs::ActuatorsConstPtr& rot_velocities);
+  void WindSpeedCallback(const rotors_comm::WindSpeedConstPtr& wind_speed);
+
+  std::unique_ptr<FirstOrderFilter<double>> rotor_velocity_filter_;
+  std::unique_ptr<FirstOrderFilter<double>> pitch_filter_;
+  std::shared_ptr<const RotorPerformanceTable> performance_table_;
+  ignition::math::Vector3<double> wind_speed_W_;
+};
+}
+
+#endif // MMUAV_PLUGINS_GAZEBO_VARIABLE_PITCH_MOTOR_MODEL_H
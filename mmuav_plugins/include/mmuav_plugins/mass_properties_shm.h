@@ -0,0 +1,70 @@
+#ifndef MMUAV_PLUGINS_MASS_PROPERTIES_SHM_H
+#define MMUAV_PLUGINS_MASS_PROPERTIES_SHM_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+namespace gazebo {
+
+static const char kMassPropertiesMagic[8] = {'M', 'M', 'U', 'A', 'V', 'M', 'P', '1'};
+static constexpr uint32_t kMassPropertiesVersion = 1;
+
+/// \brief Mass properties of a vehicle in its base link frame.
+struct MassProperties {
+  double sim_time;
+  double mass;
+  /// Centre of mass.
+  double com[3];
+  /// Inertia about the centre of mass: ixx, ixy, ixz, iyy, iyz, izz.
+  double inertia[6];
+};
+
+/// \brief Fixed layout of the shared memory file.
+struct MassPropertiesShmLayout {
+  char magic[8];
+  uint32_t version;
+  uint32_t size;
+  /// Odd while the writer is in the middle of an update.
+  uint64_t sequence;
+  MassProperties properties;
+};
+
+/**
+ * \brief Mass properties shared with co-located processes through a memory mapped file.
+ *
+ * The estimator plugin creates the file (put it in /dev/shm to keep it in
+ * memory) and writes every physics step. Controllers in other processes open
+ * it read only. Access is a sequence lock: Write() never blocks or makes a
+ * system call, Read() retries while a write is in progress, so neither side
+ * ever waits for the other.
+ */
+class MassPropertiesShm {
+ public:
+  /// \brief Creates (and resets) the file for writing.
+  /// \return nullptr if the file could not be created or mapped, errno is set.
+  static std::unique_ptr<MassPropertiesShm> Create(const std::string& path);
+  /// \brief Opens an existing file for reading.
+  /// \return nullptr if the file could not be mapped or is not a mass properties file.
+  static std::unique_ptr<MassPropertiesShm> Open(const std::string& path);
+
+  ~MassPropertiesShm();
+
+  void Write(const MassProperties& properties);
+  /// \return false if nothing has been written yet.
+  bool Read(MassProperties& properties) const;
+
+  const std::string& path() const { return path_; }
+
+ private:
+  MassPropertiesShm(const std::string& path, int fd, MassPropertiesShmLayout* layout);
+
+  std::string path_;
+  int fd_;
+  MassPropertiesShmLayout* layout_;
+};
+
+}
+
+#endif // MMUAV_PLUGINS_MASS_PROPERTIES_SHM_H
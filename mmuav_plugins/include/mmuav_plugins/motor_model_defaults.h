@@ -0,0 +1,30 @@
+#ifndef MMUAV_PLUGINS_MOTOR_MODEL_DEFAULTS_H
+#define MMUAV_PLUGINS_MOTOR_MODEL_DEFAULTS_H
+
+#include <limits>
+#include <string>
+
+// Constants shared by the rotor plugins (ducted fan, variable pitch).
+
+namespace turning_direction {
+const static int CCW = 1;
+const static int CW = -1;
+}
+
+namespace gazebo {
+// Default values
+static const std::string kDefaultCommandSubTopic = "gazebo/command/motor_speed";
+static const std::string kDefaultWindSpeedSubTopic = "gazebo/wind_speed";
+
+// Set the max_force_ to the max double value. The limitations get handled by the FirstOrderFilter.
+static constexpr double kDefaultMaxForce = std::numeric_limits<double>::max();
+static constexpr double kDefaultMotorConstant = 8.54858e-06;
+static constexpr double kDefaultMomentConstant = 0.016;
+static constexpr double kDefaultTimeConstantUp = 1.0 / 80.0;
+static constexpr double kDefaultTimeConstantDown = 1.0 / 40.0;
+static constexpr double kDefaulMaxRotVelocity = 838.0;
+static constexpr double kDefaultRotorDragCoefficient = 1.0e-4;
+static constexpr double kDefaultRollingMomentCoefficient = 1.0e-6;
+}
+
+#endif // MMUAV_PLUGINS_MOTOR_MODEL_DEFAULTS_H
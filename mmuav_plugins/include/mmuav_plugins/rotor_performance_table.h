@@ -0,0 +1,78 @@
+#ifndef MMUAV_PLUGINS_ROTOR_PERFORMANCE_TABLE_H
+#define MMUAV_PLUGINS_ROTOR_PERFORMANCE_TABLE_H
+
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+/// \brief Blade geometry and airfoil data used by the blade element/momentum solver.
+struct RotorBladeParameters {
+  int blade_count;
+  double radius;              // [m]
+  double root_cutout;         // fraction of the radius without airfoil
+  double chord;               // [m]
+  double twist;               // linear twist from root to tip [rad]
+  double lift_slope;          // [1/rad]
+  double profile_drag;        // zero lift drag coefficient
+  double fluid_density;       // [kg/m^3]
+  int elements;               // number of radial blade elements
+};
+
+/// \brief Uniform grid over one table axis.
+struct TableAxis {
+  double min;
+  double max;
+  int size;
+};
+
+/**
+ * \brief Thrust and torque of a variable pitch rotor over a pitch x rotor
+ * velocity x inflow velocity grid.
+ *
+ * The table is filled once, either by Generate(), which runs an iterative
+ * blade element/momentum solve with Prandtl tip loss for every grid point, or
+ * by Load() from a file produced offline. Lookup() is a trilinear
+ * interpolation over the uniform grid and is cheap enough for every physics
+ * step. Queries outside the grid are clamped to its border.
+ *
+ * File format (text, whitespace separated):
+ *   pitch_min pitch_max pitch_size
+ *   omega_min omega_max omega_size
+ *   inflow_min inflow_max inflow_size
+ *   thrust values, inflow index fastest, then omega, then pitch
+ *   torque values, same order
+ */
+class RotorPerformanceTable {
+ public:
+  RotorPerformanceTable();
+
+  void Generate(const RotorBladeParameters& blade, const TableAxis& pitch, const TableAxis& omega,
+                const TableAxis& inflow);
+  bool Load(const std::string& path);
+  bool Save(const std::string& path) const;
+
+  /// \brief Interpolates thrust [N] and torque [Nm] for collective pitch at 75% radius [rad], rotor velocity [rad/s]
+  /// and axial inflow velocity [m/s], positive when the rotor moves along its thrust axis (climb).
+  void Lookup(double pitch, double omega, double inflow, double& thrust, double& torque) const;
+
+  bool empty() const { return thrust_.empty(); }
+
+  /// \brief Single blade element/momentum solve, used to fill the table.
+  static void SolveBladeElementMomentum(const RotorBladeParameters& blade, double pitch, double omega,
+                                        double inflow, double& thrust, double& torque);
+
+ private:
+  size_t Index(int pitch, int omega, int inflow) const {
+    return (static_cast<size_t>(pitch) * axes_[1].size + omega) * axes_[2].size + inflow;
+  }
+
+  TableAxis axes_[3];
+  double inverse_step_[3];
+  std::vector<double> thrust_;
+  std::vector<double> torque_;
+};
+
+}
+
+#endif // MMUAV_PLUGINS_ROTOR_PERFORMANCE_TABLE_H
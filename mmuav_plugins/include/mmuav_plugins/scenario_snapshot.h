@@ -0,0 +1,64 @@
+#ifndef MMUAV_PLUGINS_SCENARIO_SNAPSHOT_H
+#define MMUAV_PLUGINS_SCENARIO_SNAPSHOT_H
+
+#include <istream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace gazebo {
+
+/// \brief Writes a plain value to a binary snapshot stream.
+template<class T>
+void writeSnapshotValue(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/// \brief Reads a plain value from a binary snapshot stream.
+template<class T>
+bool readSnapshotValue(std::istream& in, T& value) {
+  in.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return static_cast<bool>(in);
+}
+
+void writeSnapshotString(std::ostream& out, const std::string& value);
+bool readSnapshotString(std::istream& in, std::string& value);
+
+/// \brief Plugin whose internal state is saved and restored together with the world.
+class SnapshotParticipant {
+ public:
+  virtual ~SnapshotParticipant() {}
+  virtual void SaveSnapshot(std::ostream& out) const = 0;
+  virtual bool RestoreSnapshot(std::istream& in) = 0;
+};
+
+/**
+ * \brief Process wide list of snapshot participants.
+ *
+ * Plugins register themselves in Load() under a unique key (scoped model
+ * name and joint, for example) and unregister in their destructor. Save()
+ * and Restore() are called by the scenario snapshot world plugin between two
+ * physics steps, so participants do not need any locking of their own.
+ */
+class SnapshotRegistry {
+ public:
+  static SnapshotRegistry& Instance();
+
+  void Register(const std::string& key, SnapshotParticipant* participant);
+  void Unregister(const std::string& key);
+
+  void Save(std::ostream& out);
+  /// \return Number of participants restored, or -1 if the stream is malformed.
+  int Restore(std::istream& in);
+
+ private:
+  SnapshotRegistry() {}
+
+  std::mutex mutex_;
+  std::map<std::string, SnapshotParticipant*> participants_;
+};
+
+}
+
+#endif // MMUAV_PLUGINS_SCENARIO_SNAPSHOT_H
@@ -0,0 +1,60 @@
+#ifndef MMUAV_PLUGINS_SERIAL_HIL_LINK_H
+#define MMUAV_PLUGINS_SERIAL_HIL_LINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Frame of the arducopter stepper board, as written by GazeboToArducopterSerial:
+// four little endian int32 values, a terminator byte and three zero bytes.
+static const size_t kSerialFrameValues = 4;
+static const size_t kSerialFrameSize = 4 * kSerialFrameValues + 4;
+static const uint8_t kSerialMassCommandTerminator = 67;     // 'C'
+static const uint8_t kSerialParameterTerminator = 83;       // 'S'
+static const uint8_t kSerialMassReadbackTerminator = 80;    // 'P'
+
+struct SerialFrame {
+  int32_t values[kSerialFrameValues];
+  uint8_t terminator;
+};
+
+void EncodeSerialFrame(const SerialFrame& frame, uint8_t* buffer);
+
+/**
+ * \brief Serial device or pseudo terminal speaking the stepper board frames.
+ *
+ * All calls are non-blocking except Read() with a timeout. Received bytes
+ * are collected until a complete frame is found, bytes that do not line up
+ * with a terminator and the three zero bytes are skipped, so the link
+ * resynchronizes after garbage or a partial frame.
+ */
+class SerialHilLink {
+ public:
+  SerialHilLink();
+  ~SerialHilLink();
+
+  bool Open(const std::string& device, int baudrate);
+  /// \brief Opens the master side of a new pty, the board stand-in opens SlaveName().
+  bool OpenPty();
+  void Close();
+
+  bool IsOpen() const { return fd_ >= 0; }
+  const std::string& SlaveName() const { return slave_name_; }
+  const std::string& Error() const { return error_; }
+
+  bool Write(const SerialFrame& frame);
+  /// \brief Next frame with the given terminator, waits up to timeout seconds for it.
+  bool Read(uint8_t terminator, double timeout, SerialFrame& frame);
+
+ private:
+  bool FillBuffer(double timeout);
+  bool ExtractFrame(uint8_t terminator, SerialFrame& frame);
+
+  int fd_;
+  std::string slave_name_;
+  std::string error_;
+  std::vector<uint8_t> buffer_;
+};
+
+#endif // MMUAV_PLUGINS_SERIAL_HIL_LINK_H
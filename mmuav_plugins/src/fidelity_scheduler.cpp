@@ -0,0 +1,179 @@
+#include "mmuav_plugins/fidelity_scheduler.h"
+
+#include <map>
+
+namespace gazebo {
+
+namespace {
+// One scheduler per world, created by the first vehicle and released with the last one.
+std::mutex schedulers_mutex;
+std::map<std::string, std::weak_ptr<FidelityScheduler>> schedulers;
+
+double Seconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+}
+
+const char* FidelityLevelName(FidelityLevel level) {
+  switch (level) {
+    case FidelityLevel::Full:
+      return "full";
+    case FidelityLevel::Reduced:
+      return "reduced";
+    case FidelityLevel::Minimal:
+      return "minimal";
+  }
+  return "unknown";
+}
+
+bool ParseFidelityLevel(const std::string& name, FidelityLevel& level) {
+  if (name == "full")
+    level = FidelityLevel::Full;
+  else if (name == "reduced")
+    level = FidelityLevel::Reduced;
+  else if (name == "minimal")
+    level = FidelityLevel::Minimal;
+  else
+    return false;
+  return true;
+}
+
+std::shared_ptr<FidelityScheduler> FidelityScheduler::Get(physics::WorldPtr world) {
+  std::lock_guard<std::mutex> lock(schedulers_mutex);
+  std::shared_ptr<FidelityScheduler> scheduler = schedulers[world->Name()].lock();
+  if (!scheduler) {
+    scheduler.reset(new FidelityScheduler(world));
+    schedulers[world->Name()] = scheduler;
+  }
+  return scheduler;
+}
+
+FidelityScheduler::FidelityScheduler(physics::WorldPtr world)
+    : world_(world),
+      configured_(false),
+      window_sim_begin_(0.0),
+      window_step_cost_(0.0),
+      window_steps_(0),
+      window_started_(false) {
+  update_begin_connection_ = event::Events::ConnectWorldUpdateBegin(
+      boost::bind(&FidelityScheduler::OnUpdateBegin, this, _1));
+  update_end_connection_ = event::Events::ConnectWorldUpdateEnd(
+      boost::bind(&FidelityScheduler::OnUpdateEnd, this));
+}
+
+FidelityScheduler::~FidelityScheduler() {
+  update_begin_connection_.reset();
+  update_end_connection_.reset();
+}
+
+void FidelityScheduler::Configure(const FidelitySchedulerParams& params) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (configured_) {
+    if (params.target_real_time_factor != params_.target_real_time_factor ||
+        params.degrade_real_time_factor != params_.degrade_real_time_factor ||
+        params.upgrade_load != params_.upgrade_load || params.window != params_.window ||
+        params.switch_interval != params_.switch_interval)
+      gzwarn << "[fidelity_scheduler] The fidelity thresholds are per world, the ones of the first vehicle are "
+             << "kept and later differing ones are ignored.\n";
+    return;
+  }
+  params_ = params;
+  configured_ = true;
+}
+
+std::shared_ptr<FidelityVehicle> FidelityScheduler::Register(const std::string& vehicle, int priority,
+                                                             FidelityLevel level) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::weak_ptr<FidelityVehicle>& entry : vehicles_) {
+    std::shared_ptr<FidelityVehicle> existing = entry.lock();
+    if (existing && existing->name == vehicle)
+      return existing;
+  }
+  std::shared_ptr<FidelityVehicle> entry(new FidelityVehicle());
+  entry->name = vehicle;
+  entry->priority = priority;
+  entry->level.store(static_cast<int>(level));
+  vehicles_.push_back(entry);
+  return entry;
+}
+
+void FidelityScheduler::OnUpdateBegin(const common::UpdateInfo& _info) {
+  Clock::time_point now = Clock::now();
+  step_begin_ = now;
+  double sim_time = _info.simTime.Double();
+
+  // A pause or a world reset would show up as a slow window, start over instead.
+  double wall_time = Seconds(now - window_begin_);
+  if (!window_started_ || sim_time < window_sim_begin_ || wall_time > 5.0 * params_.window) {
+    window_begin_ = now;
+    window_sim_begin_ = sim_time;
+    window_step_cost_ = 0.0;
+    window_steps_ = 0;
+    if (!window_started_)
+      last_switch_ = now;
+    window_started_ = true;
+    return;
+  }
+  if (wall_time < params_.window || window_steps_ == 0)
+    return;
+
+  double real_time_factor = (sim_time - window_sim_begin_) / wall_time;
+  double step_budget = world_->Physics()->GetMaxStepSize() / params_.target_real_time_factor;
+  double load = window_step_cost_ / window_steps_ / step_budget;
+  if (Seconds(now - last_switch_) >= params_.switch_interval)
+    Evaluate(real_time_factor, load);
+
+  window_begin_ = now;
+  window_sim_begin_ = sim_time;
+  window_step_cost_ = 0.0;
+  window_steps_ = 0;
+}
+
+void FidelityScheduler::OnUpdateEnd() {
+  if (!window_started_)
+    return;
+  window_step_cost_ += Seconds(Clock::now() - step_begin_);
+  window_steps_++;
+}
+
+void FidelityScheduler::Evaluate(double real_time_factor, double load) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool degrade = real_time_factor < params_.degrade_real_time_factor * params_.target_real_time_factor;
+  bool upgrade = !degrade && load < params_.upgrade_load;
+  if (!degrade && !upgrade)
+    return;
+
+  std::shared_ptr<FidelityVehicle> selected;
+  for (size_t i = 0; i < vehicles_.size();) {
+    std::shared_ptr<FidelityVehicle> vehicle = vehicles_[i].lock();
+    if (!vehicle) {
+      vehicles_.erase(vehicles_.begin() + i);
+      continue;
+    }
+    i++;
+    int level = vehicle->level.load(std::memory_order_relaxed);
+    if (degrade && level < static_cast<int>(FidelityLevel::Minimal) &&
+        (!selected || vehicle->priority < selected->priority))
+      selected = vehicle;
+    if (upgrade && level > static_cast<int>(FidelityLevel::Full) &&
+        (!selected || vehicle->priority > selected->priority))
+      selected = vehicle;
+  }
+  if (!selected)
+    return;
+
+  int level = selected->level.load(std::memory_order_relaxed) + (degrade ? 1 : -1);
+  Switch(*selected, static_cast<FidelityLevel>(level), real_time_factor, load);
+  last_switch_ = Clock::now();
+}
+
+void FidelityScheduler::Switch(FidelityVehicle& vehicle, FidelityLevel level, double real_time_factor,
+                               double load) {
+  FidelityLevel previous = static_cast<FidelityLevel>(vehicle.level.load(std::memory_order_relaxed));
+  vehicle.level.store(static_cast<int>(level), std::memory_order_relaxed);
+  gzmsg << "[fidelity_scheduler] " << vehicle.name << ": " << FidelityLevelName(previous) << " -> "
+        << FidelityLevelName(level) << " (real time factor " << real_time_factor << ", step load "
+        << load << ")\n";
+}
+
+}
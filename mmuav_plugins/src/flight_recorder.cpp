@@ -0,0 +1,88 @@
+#include "mmuav_plugins/flight_recorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+namespace gazebo {
+
+namespace {
+// Recorders are shared between the motor plugins of a model, keyed on the file path.
+std::mutex registry_mutex;
+std::map<std::string, std::weak_ptr<FlightRecorder>> registry;
+}
+
+std::shared_ptr<FlightRecorder> FlightRecorder::Open(const std::string& path, uint64_t capacity) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  auto it = registry.find(path);
+  if (it != registry.end()) {
+    std::shared_ptr<FlightRecorder> recorder = it->second.lock();
+    if (recorder)
+      return recorder;
+  }
+
+  if (capacity == 0) {
+    errno = EINVAL;
+    return nullptr;
+  }
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return nullptr;
+
+  size_t map_size = sizeof(FlightRecorderHeader) + capacity * sizeof(FlightRecord);
+  if (ftruncate(fd, map_size) != 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return nullptr;
+  }
+
+  void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return nullptr;
+  }
+
+  FlightRecorderHeader* header = static_cast<FlightRecorderHeader*>(map);
+  memcpy(header->magic, kFlightRecorderMagic, sizeof(header->magic));
+  header->version = kFlightRecorderVersion;
+  header->record_size = sizeof(FlightRecord);
+  header->capacity = capacity;
+  header->write_count = 0;
+
+  std::shared_ptr<FlightRecorder> recorder(new FlightRecorder(path, fd, map, map_size));
+  registry[path] = recorder;
+  return recorder;
+}
+
+FlightRecorder::FlightRecorder(const std::string& path, int fd, void* map, size_t map_size)
+    : path_(path),
+      fd_(fd),
+      map_(map),
+      map_size_(map_size),
+      header_(static_cast<FlightRecorderHeader*>(map)),
+      records_(reinterpret_cast<FlightRecord*>(static_cast<char*>(map) + sizeof(FlightRecorderHeader))) {}
+
+FlightRecorder::~FlightRecorder() {
+  msync(map_, map_size_, MS_ASYNC);
+  munmap(map_, map_size_);
+  close(fd_);
+}
+
+void FlightRecorder::Write(const FlightRecord& record) {
+  // Reserve the slot first, so rotors updated from different threads never share one.
+  uint64_t index = __atomic_fetch_add(&header_->write_count, 1, __ATOMIC_RELAXED);
+  records_[index % header_->capacity] = record;
+}
+
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+File name: flight_recorder_export.cpp
+Description: Converts a motor plugin flight recorder file to csv.
+Usage: flight_recorder_export <recorder_file> [output.csv] [motor_number]
+******************************************************************************/
+
+#include "mmuav_plugins/flight_recorder.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace gazebo;
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <recorder_file> [output.csv] [motor_number]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Could not open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    FlightRecorderHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || memcmp(header.magic, kFlightRecorderMagic, sizeof(header.magic)) != 0)
+    {
+        std::cerr << argv[1] << " is not a flight recorder file." << std::endl;
+        return 1;
+    }
+    if (header.version != kFlightRecorderVersion || header.record_size != sizeof(FlightRecord))
+    {
+        std::cerr << "Unsupported recorder version " << header.version
+            << " (record size " << header.record_size << ")." << std::endl;
+        return 1;
+    }
+
+    std::vector<FlightRecord> records(header.capacity);
+    in.read(reinterpret_cast<char*>(records.data()), header.capacity * sizeof(FlightRecord));
+    if (!in)
+    {
+        std::cerr << "Recorder file is truncated." << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    if (argc > 2) file.open(argv[2]);
+    std::ostream &out = argc > 2 ? file : std::cout;
+    int motor_filter = argc > 3 ? atoi(argv[3]) : -1;
+
+    // Once the ring has wrapped the oldest record sits right after the newest one.
+    uint64_t count = header.write_count < header.capacity ? header.write_count : header.capacity;
+    uint64_t first = header.write_count - count;
+
+    out << "sim_time,motor_number,rotor_velocity,flap_angle,"
+        << "force_x,force_y,force_z,moment_x,moment_y,moment_z,"
+        << "drag_x,drag_y,drag_z,rolling_moment_x,rolling_moment_y,rolling_moment_z" << std::endl;
+    out.precision(9);
+    for (uint64_t i = first; i < header.write_count; i++)
+    {
+        const FlightRecord &r = records[i % header.capacity];
+        if (motor_filter >= 0 && r.motor_number != motor_filter) continue;
+        out << r.sim_time << "," << r.motor_number << "," << r.rotor_velocity << "," << r.flap_angle;
+        for (int j = 0; j < 3; j++) out << "," << r.force[j];
+        for (int j = 0; j < 3; j++) out << "," << r.moment[j];
+        for (int j = 0; j < 3; j++) out << "," << r.drag[j];
+        for (int j = 0; j < 3; j++) out << "," << r.rolling_moment[j];
+        out << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "mmuav_plugins/gazebo_dipole_magnet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+namespace gazebo {
+
+namespace {
+// One registry per world, created by the first magnet and released with the last one.
+std::mutex registries_mutex;
+std::map<std::string, std::weak_ptr<DipoleMagnetRegistry>> registries;
+}
+
+std::shared_ptr<DipoleMagnetRegistry> DipoleMagnetRegistry::Get(physics::WorldPtr world) {
+  std::lock_guard<std::mutex> lock(registries_mutex);
+  std::shared_ptr<DipoleMagnetRegistry> registry = registries[world->Name()].lock();
+  if (!registry) {
+    registry.reset(new DipoleMagnetRegistry(world));
+    registries[world->Name()] = registry;
+  }
+  return registry;
+}
+
+DipoleMagnetRegistry::DipoleMagnetRegistry(physics::WorldPtr world)
+    : world_(world),
+      cutoff_distance_(0.0),
+      min_distance_(0.0) {
+  updateConnection_ = event::Events::ConnectWorldUpdateBegin(boost::bind(&DipoleMagnetRegistry::OnUpdate, this, _1));
+}
+
+DipoleMagnetRegistry::~DipoleMagnetRegistry() {
+  updateConnection_.reset();
+}
+
+void DipoleMagnetRegistry::Add(DipoleMagnet* magnet, double cutoff_distance, double min_distance) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  magnets_.push_back(magnet);
+  // The hash uses a single cell size, so the largest cutoff of all magnets wins.
+  cutoff_distance_ = std::max(cutoff_distance_, cutoff_distance);
+  min_distance_ = std::max(min_distance_, min_distance);
+  cells_.reserve(magnets_.size());
+}
+
+void DipoleMagnetRegistry::Remove(DipoleMagnet* magnet) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  magnets_.erase(std::remove(magnets_.begin(), magnets_.end(), magnet), magnets_.end());
+}
+
+int64_t DipoleMagnetRegistry::CellKey(int x, int y, int z) const {
+  // 21 bits per axis, enough for +-10^6 cells.
+  const int64_t offset = 1 << 20;
+  const int64_t mask = (1 << 21) - 1;
+  return (((x + offset) & mask) << 42) | (((y + offset) & mask) << 21) | ((z + offset) & mask);
+}
+
+void DipoleMagnetRegistry::CellOf(const ignition::math::Vector3d& position, int& x, int& y, int& z) const {
+  x = static_cast<int>(std::floor(position.X() / cutoff_distance_));
+  y = static_cast<int>(std::floor(position.Y() / cutoff_distance_));
+  z = static_cast<int>(std::floor(position.Z() / cutoff_distance_));
+}
+
+void DipoleMagnetRegistry::ApplyPair(DipoleMagnet& a, DipoleMagnet& b) const {
+  ignition::math::Vector3d r = b.position_world - a.position_world;
+  double distance = r.Length();
+  if (distance >= cutoff_distance_)
+    return;
+  ignition::math::Vector3d r_hat = distance > 0.0 ? r / distance : ignition::math::Vector3d::UnitZ;
+  distance = std::max(distance, min_distance_);
+
+  const ignition::math::Vector3d& m_a = a.moment_world;
+  const ignition::math::Vector3d& m_b = b.moment_world;
+  double m_a_r = m_a.Dot(r_hat);
+  double m_b_r = m_b.Dot(r_hat);
+
+  // Force of dipole a on dipole b, b pushes back with the opposite force.
+  double distance_3 = distance * distance * distance;
+  ignition::math::Vector3d force = 3.0 * kMagneticConstantOver4Pi / (distance_3 * distance) *
+      (m_a_r * m_b + m_b_r * m_a + m_a.Dot(m_b) * r_hat - 5.0 * m_a_r * m_b_r * r_hat);
+  b.force_world += force;
+  a.force_world -= force;
+
+  // Torque on each dipole from the field of the other, B = k/r^3 * (3 (m.r) r - m).
+  ignition::math::Vector3d field_a = kMagneticConstantOver4Pi / distance_3 * (3.0 * m_a_r * r_hat - m_a);
+  ignition::math::Vector3d field_b = kMagneticConstantOver4Pi / distance_3 * (3.0 * m_b_r * r_hat - m_b);
+  b.torque_world += m_b.Cross(field_a);
+  a.torque_world += m_a.Cross(field_b);
+}
+
+void DipoleMagnetRegistry::OnUpdate(const common::UpdateInfo& _info) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int count = magnets_.size();
+  if (count == 0 || cutoff_distance_ <= 0.0)
+    return;
+
+  cells_.resize(count);
+  int x, y, z;
+  for (int i = 0; i < count; i++) {
+    DipoleMagnet& magnet = *magnets_[i];
+    ignition::math::Pose3d pose = magnet.link->WorldPose();
+    magnet.position_world = pose.Pos();
+    magnet.moment_world = magnet.gain.load(std::memory_order_relaxed) * pose.Rot().RotateVector(magnet.moment_body);
+    magnet.force_world = ignition::math::Vector3d::Zero;
+    magnet.torque_world = ignition::math::Vector3d::Zero;
+    CellOf(magnet.position_world, x, y, z);
+    cells_[i] = std::make_pair(CellKey(x, y, z), i);
+  }
+  std::sort(cells_.begin(), cells_.end());
+
+  // Every pair closer than the cutoff lies in one of the 27 cells around a magnet.
+  for (int i = 0; i < count; i++) {
+    CellOf(magnets_[i]->position_world, x, y, z);
+    for (int dx = -1; dx <= 1; dx++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dz = -1; dz <= 1; dz++) {
+          std::pair<int64_t, int> first(CellKey(x + dx, y + dy, z + dz), 0);
+          for (auto it = std::lower_bound(cells_.begin(), cells_.end(), first);
+               it != cells_.end() && it->first == first.first; ++it) {
+            if (it->second > i)
+              ApplyPair(*magnets_[i], *magnets_[it->second]);
+          }
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    magnets_[i]->link->AddForce(magnets_[i]->force_world);
+    magnets_[i]->link->AddTorque(magnets_[i]->torque_world);
+  }
+}
+
+GazeboDipoleMagnet::~GazeboDipoleMagnet() {
+  updateConnection_.reset();
+  if (registry_)
+    registry_->Remove(&magnet_);
+  if (node_handle_) {
+    node_handle_->shutdown();
+    delete node_handle_;
+  }
+}
+
+void GazeboDipoleMagnet::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
+  model_ = _model;
+
+  getSdfParam<std::string>(_sdf, "robotNamespace", namespace_, namespace_);
+  node_handle_ = new ros::NodeHandle(namespace_);
+
+  if (_sdf->HasElement("bodyName"))
+    body_name_ = _sdf->GetElement("bodyName")->Get<std::string>();
+  else
+    gzerr << "[gazebo_dipole_magnet] Please specify a bodyName of the magnet link.\n";
+  magnet_.link = model_->GetLink(body_name_);
+  if (magnet_.link == NULL)
+    gzthrow("[gazebo_dipole_magnet] Couldn't find specified link \"" << body_name_ << "\".");
+
+  double gain;
+  int should_publish;
+  getSdfParam<ignition::math::Vector3d>(_sdf, "dipole_moment", magnet_.moment_body, ignition::math::Vector3d::Zero);
+  getSdfParam<double>(_sdf, "gain", gain, 1.0);
+  getSdfParam<int>(_sdf, "shouldPublish", should_publish, 0);
+  getSdfParam<std::string>(_sdf, "topicNs", topic_ns_, model_->GetName());
+  getSdfParam<double>(_sdf, "updateRate", update_rate_, update_rate_);
+  getSdfParam<double>(_sdf, "cutoffDistance", cutoff_distance_, cutoff_distance_);
+  getSdfParam<double>(_sdf, "minDistance", min_distance_, min_distance_);
+  magnet_.gain.store(gain);
+  should_publish_ = should_publish != 0;
+
+  registry_ = DipoleMagnetRegistry::Get(model_->GetWorld());
+  registry_->Add(&magnet_, cutoff_distance_, min_distance_);
+
+  // Gain changes are handed to the physics thread through an atomic, without locking.
+  gain_sub_ = node_handle_->subscribe(topic_ns_ + "/gain", 1, &GazeboDipoleMagnet::GainCallback, this);
+  if (should_publish_) {
+    wrench_pub_ = node_handle_->advertise<geometry_msgs::WrenchStamped>(topic_ns_ + "/wrench", 1);
+    wrench_msg_.header.frame_id = "world";
+    updateConnection_ = event::Events::ConnectWorldUpdateBegin(boost::bind(&GazeboDipoleMagnet::OnUpdate, this, _1));
+  }
+}
+
+// Publishes the magnetic wrench computed by the registry in the previous step.
+void GazeboDipoleMagnet::OnUpdate(const common::UpdateInfo& _info) {
+  if (update_rate_ > 0.0 && _info.simTime.Double() - prev_publish_time_ < 1.0 / update_rate_)
+    return;
+  prev_publish_time_ = _info.simTime.Double();
+
+  wrench_msg_.header.stamp.fromSec(_info.simTime.Double());
+  wrench_msg_.wrench.force.x = magnet_.force_world.X();
+  wrench_msg_.wrench.force.y = magnet_.force_world.Y();
+  wrench_msg_.wrench.force.z = magnet_.force_world.Z();
+  wrench_msg_.wrench.torque.x = magnet_.torque_world.X();
+  wrench_msg_.wrench.torque.y = magnet_.torque_world.Y();
+  wrench_msg_.wrench.torque.z = magnet_.torque_world.Z();
+  wrench_pub_.publish(wrench_msg_);
+}
+
+void GazeboDipoleMagnet::GainCallback(const std_msgs::Float64ConstPtr& msg) {
+  magnet_.gain.store(msg->data, std::memory_order_relaxed);
+}
+
+GZ_REGISTER_MODEL_PLUGIN(GazeboDipoleMagnet);
+}
@@ -1,10 +1,15 @@
 #include "mmuav_plugins/gazebo_ductedfan_motor_model.h"
+#include <cerrno>
 #include <cmath>
+#include <cstring>
+#include <sstream>
 
 namespace gazebo {
 
 GazeboMotorModel::~GazeboMotorModel() {
   updateConnection_.reset();
+  if (!snapshot_key_.empty())
+    SnapshotRegistry::Instance().Unregister(snapshot_key_);
   if (node_handle_) {
     node_handle_->shutdown();
     delete node_handle_;
@@ -13,12 +18,57 @@ GazeboMotorModel::~GazeboMotorModel() {
 
 void GazeboMotorModel::InitializeParams() {}
 
+void GazeboMotorModel::SaveSnapshot(std::ostream& out) const {
+  writeSnapshotValue<uint32_t>(out, kMotorModelSnapshotVersion);
+  writeSnapshotValue(out, prev_sim_time_);
+  writeSnapshotValue(out, sampling_time_);
+  writeSnapshotValue(out, motor_rot_vel_);
+  writeSnapshotValue(out, ref_motor_rot_vel_);
+  writeSnapshotValue(out, rotor_velocity_filter_->getState());
+  writeSnapshotValue(out, kinematic_rotor_velocity_);
+  writeSnapshotValue(out, angle_control_flap_);
+  writeSnapshotValue(out, angle_control_flap_ref_);
+  writeSnapshotValue(out, flap_servo_ ? flap_servo_->getShaftAngle() : angle_control_flap_);
+  writeSnapshotValue(out, flap_servo_ ? flap_servo_->getFlapAngle() : angle_control_flap_);
+  writeSnapshotValue(out, wind_speed_W_.X());
+  writeSnapshotValue(out, wind_speed_W_.Y());
+  writeSnapshotValue(out, wind_speed_W_.Z());
+}
+
+bool GazeboMotorModel::RestoreSnapshot(std::istream& in) {
+  uint32_t version;
+  double filter_state, shaft_angle, flap_angle, wind_x, wind_y, wind_z;
+  if (!readSnapshotValue(in, version) || version != kMotorModelSnapshotVersion) {
+    gzerr << "[gazebo_motor_model] Unsupported snapshot of motor [" << motor_number_ << "].\n";
+    return false;
+  }
+  bool ok = readSnapshotValue(in, prev_sim_time_) && readSnapshotValue(in, sampling_time_) &&
+      readSnapshotValue(in, motor_rot_vel_) && readSnapshotValue(in, ref_motor_rot_vel_) &&
+      readSnapshotValue(in, filter_state) && readSnapshotValue(in, kinematic_rotor_velocity_) &&
+      readSnapshotValue(in, angle_control_flap_) && readSnapshotValue(in, angle_control_flap_ref_) &&
+      readSnapshotValue(in, shaft_angle) && readSnapshotValue(in, flap_angle) &&
+      readSnapshotValue(in, wind_x) && readSnapshotValue(in, wind_y) && readSnapshotValue(in, wind_z);
+  if (!ok) {
+    gzerr << "[gazebo_motor_model] Truncated snapshot of motor [" << motor_number_ << "].\n";
+    return false;
+  }
+
+  rotor_velocity_filter_->setState(filter_state);
+  if (flap_servo_)
+    flap_servo_->setState(shaft_angle, flap_angle);
+  wind_speed_W_.Set(wind_x, wind_y, wind_z);
+  return true;
+}
+
 void GazeboMotorModel::Publish() {
-  turning_velocity_msg_.data = joint_->GetVelocity(0);
+  turning_velocity_msg_.data = kinematic_rotor_ ? motor_rot_vel_ : joint_->GetVelocity(0);
   motor_velocity_pub_.publish(turning_velocity_msg_);
 
-  angle_control_flap_command_msg_.data = angle_control_flap_ref_;
-  angle_control_flap_command_pub_.publish(angle_control_flap_command_msg_);  
+  // With the internal servo the flap angle never leaves the plugin.
+  if (!use_internal_flap_servo_) {
+    angle_control_flap_command_msg_.data = angle_control_flap_ref_;
+    angle_control_flap_command_pub_.publish(angle_control_flap_command_msg_);
+  }
 }
 
 void GazeboMotorModel::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
@@ -113,6 +163,79 @@ void GazeboMotorModel::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
   getSdfParam<double>(_sdf, "liftCoefficientAntitorqueFlapAt0", lift_coefficient_antitorque_flap_at0_, lift_coefficient_antitorque_flap_at0_);
   getSdfParam<double>(_sdf, "dragCoefficientAntitorqueFlapAt0", drag_coefficient_antitorque_flap_at0_, drag_coefficient_antitorque_flap_at0_);
 
+  // Rotor layout. The flap axis and lever arm used to follow from motorNumber (0/2 x, 1/3 y),
+  // which is still the default so existing quadrotor descriptions keep working.
+  ignition::math::Vector3d flap_axis;
+  double flap_lever_arm;
+  if (_sdf->HasElement("flapAxis"))
+    flap_axis = _sdf->GetElement("flapAxis")->Get<ignition::math::Vector3d>();
+  else if (motor_number_ >= 0 && motor_number_ <= 3)
+    flap_axis = motor_number_ % 2 == 0 ? ignition::math::Vector3d::UnitX : ignition::math::Vector3d::UnitY;
+  else
+    gzthrow("[gazebo_motor_model] Please specify a flapAxis for motor " << motor_number_ << ".");
+  getSdfParam<double>(_sdf, "flapLeverArm", flap_lever_arm, distance_control_flap_);
+
+  // The antitorque flaps stay at zero angle, only their drag at 0 is left in the formulas.
+  geometry_.flap_force = fluid_density_ * area_control_flap_ * lift_coefficient_control_flap_ * flap_axis;
+  geometry_.flap_moment = flap_lever_arm * geometry_.flap_force;
+  geometry_.drag_at0 = fluid_density_ * (area_antitorque_flap_ * drag_coefficient_antitorque_flap_at0_ +
+                                         area_control_flap_ * drag_coefficient_control_flap_at0_);
+  geometry_.drag_flap = fluid_density_ * area_control_flap_ * drag_coefficient_control_flap_;
+  geometry_.yaw_moment = -turning_direction_ * torque_coefficient_;
+
+  physics::Link_V parent_links = link_->GetParentJointsLinks();
+  if (parent_links.empty())
+    gzthrow("[gazebo_motor_model] Link \"" << link_name_ << "\" has no parent link to apply the moments to.");
+  parent_link_ = parent_links.at(0);
+
+  getSdfParam<bool>(_sdf, "useInternalFlapServo", use_internal_flap_servo_, use_internal_flap_servo_);
+  getSdfParam<double>(_sdf, "flapServoBandwidth", flap_servo_bandwidth_, flap_servo_bandwidth_);
+  getSdfParam<double>(_sdf, "flapServoMaxRate", flap_servo_max_rate_, flap_servo_max_rate_);
+  getSdfParam<double>(_sdf, "flapServoBacklash", flap_servo_backlash_, flap_servo_backlash_);
+  getSdfParam<double>(_sdf, "flapServoMaxAngle", flap_servo_max_angle_, flap_servo_max_angle_);
+
+  getSdfParam<bool>(_sdf, "kinematicRotor", kinematic_rotor_, kinematic_rotor_);
+  getSdfParam<bool>(_sdf, "visualRotorSpin", visual_rotor_spin_, visual_rotor_spin_);
+
+  getSdfParam<std::string>(_sdf, "flightRecorderFile", flight_recorder_file_, flight_recorder_file_);
+  getSdfParam<int>(_sdf, "flightRecorderCapacity", flight_recorder_capacity_, flight_recorder_capacity_);
+
+  std::string mixer_attitude_inputs;
+  getSdfParam<std::string>(_sdf, "mixerFile", mixer_file_, mixer_file_);
+  getSdfParam<std::string>(_sdf, "mixerThrustSubTopic", mixer_thrust_sub_topic_, mixer_thrust_sub_topic_);
+  getSdfParam<std::string>(_sdf, "mixerAttitudeSubTopic", mixer_attitude_sub_topic_, mixer_attitude_sub_topic_);
+  getSdfParam<std::string>(_sdf, "mixerAttitudeInputs", mixer_attitude_inputs, kDefaultMixerAttitudeInputs);
+  std::istringstream attitude_inputs(mixer_attitude_inputs);
+  for (int input; attitude_inputs >> input;)
+    mixer_attitude_inputs_.push_back(input);
+
+  // Aerodynamic detail, either fixed or switched by the world's fidelity scheduler.
+  std::string fidelity_level;
+  bool adaptive_fidelity = false;
+  int fidelity_priority;
+  FidelitySchedulerParams fidelity_params;
+  getSdfParam<std::string>(_sdf, "fidelityLevel", fidelity_level, FidelityLevelName(fidelity_level_));
+  if (!ParseFidelityLevel(fidelity_level, fidelity_level_))
+    gzerr << "[gazebo_motor_model] Please only use 'full', 'reduced' or 'minimal' as fidelityLevel.\n";
+  getSdfParam<bool>(_sdf, "adaptiveFidelity", adaptive_fidelity, adaptive_fidelity);
+  getSdfParam<int>(_sdf, "fidelityPriority", fidelity_priority, 0);
+  getSdfParam<double>(_sdf, "fidelityTargetRealTimeFactor", fidelity_params.target_real_time_factor,
+                      fidelity_params.target_real_time_factor);
+  getSdfParam<double>(_sdf, "fidelityDegradeRealTimeFactor", fidelity_params.degrade_real_time_factor,
+                      fidelity_params.degrade_real_time_factor);
+  getSdfParam<double>(_sdf, "fidelityUpgradeLoad", fidelity_params.upgrade_load, fidelity_params.upgrade_load);
+  getSdfParam<double>(_sdf, "fidelityWindow", fidelity_params.window, fidelity_params.window);
+  getSdfParam<double>(_sdf, "fidelitySwitchInterval", fidelity_params.switch_interval,
+                      fidelity_params.switch_interval);
+
+  if (adaptive_fidelity) {
+    // All rotors of the model share one entry, so a vehicle always switches as a whole.
+    // fidelityLevel is the level it starts at.
+    fidelity_scheduler_ = FidelityScheduler::Get(model_->GetWorld());
+    fidelity_scheduler_->Configure(fidelity_params);
+    fidelity_vehicle_ = fidelity_scheduler_->Register(model_->GetScopedName(), fidelity_priority,
+                                                     fidelity_level_);
+  }
 
   //std::cout << "fluid density " <<fluid_density_ << std::endl;
   // std::cout << area_control_flap_ << std::endl;
@@ -140,19 +263,56 @@ void GazeboMotorModel::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
   updateConnection_ = event::Events::ConnectWorldUpdateBegin(boost::bind(&GazeboMotorModel::OnUpdate, this, _1));
 
   //Publishers and Subscribers
-  command_sub_ = node_handle_->subscribe(command_sub_topic_, 1, &GazeboMotorModel::VelocityCallback, this);
+  if (!mixer_file_.empty()) {
+    // Controller outputs are mixed in here, without a separate mixer node in between.
+    std::string error, warning;
+    mixer_.reset(new MixerEngine());
+    if (!mixer_->load(mixer_file_, error, warning))
+      gzthrow("[gazebo_motor_model] Couldn't load mixer \"" << mixer_file_ << "\": " << error);
+    if (mixer_->outputCount() <= motor_number_)
+      gzthrow("[gazebo_motor_model] Mixer \"" << mixer_file_ << "\" has no output for motor " << motor_number_ << ".");
+    if (!warning.empty())
+      gzwarn << "[gazebo_motor_model] Mixer \"" << mixer_file_ << "\": " << warning << "\n";
+    mixer_input_.reset(new MixerEngine::InputVector(MixerEngine::InputVector::Zero()));
+    mixer_thrust_sub_ = node_handle_->subscribe(mixer_thrust_sub_topic_, 1, &GazeboMotorModel::MixerThrustCallback, this);
+    mixer_attitude_sub_ = node_handle_->subscribe(mixer_attitude_sub_topic_, 1, &GazeboMotorModel::MixerAttitudeCallback, this);
+  }
+  else {
+    command_sub_ = node_handle_->subscribe(command_sub_topic_, 1, &GazeboMotorModel::VelocityCallback, this);
+  }
   wind_speed_sub_ = node_handle_->subscribe(wind_speed_sub_topic_, 1, &GazeboMotorModel::WindSpeedCallback, this);
   motor_velocity_pub_ = node_handle_->advertise<std_msgs::Float32>(motor_speed_pub_topic_, 1);
 
   //angle_control_flap_sub__ subscribes to the outer reference values, basicly gui
   angle_control_flap_ref_sub_ = node_handle_->subscribe(angle_control_flap_ref_sub_topic_, 1, &GazeboMotorModel::AngleControlFlapRefCallback, this);
-  //angle_control_flap_command_pub__ publishes values to the angle controllers  
-  angle_control_flap_command_pub_ = node_handle_->advertise<std_msgs::Float64>(angle_control_flap_command_pub_topic_, 1);
-  //angle_control_flap_value_sub_ subscribes to the actual process values (real angle value, not the reference)
-  angle_control_flap_value_sub_ = node_handle_->subscribe(angle_control_flap_value_sub_topic_, 1, &GazeboMotorModel::AngleControlFlapValueCallback, this);
+  if (use_internal_flap_servo_) {
+    // The flap servo is integrated in UpdateForcesAndMoments(), no external angle controller is needed.
+    flap_servo_.reset(new FlapServoModel(flap_servo_bandwidth_, flap_servo_max_rate_, flap_servo_backlash_,
+                                         flap_servo_max_angle_, angle_control_flap_));
+  }
+  else {
+    //angle_control_flap_command_pub__ publishes values to the angle controllers  
+    angle_control_flap_command_pub_ = node_handle_->advertise<std_msgs::Float64>(angle_control_flap_command_pub_topic_, 1);
+    //angle_control_flap_value_sub_ subscribes to the actual process values (real angle value, not the reference)
+    angle_control_flap_value_sub_ = node_handle_->subscribe(angle_control_flap_value_sub_topic_, 1, &GazeboMotorModel::AngleControlFlapValueCallback, this);
+  }
   
   // Create the first order filter.
   rotor_velocity_filter_.reset(new FirstOrderFilter<double>(time_constant_up_, time_constant_down_, ref_motor_rot_vel_));
+
+  // Make the internal state available to the scenario snapshot world plugin.
+  snapshot_key_ = model_->GetScopedName() + "::" + joint_name_;
+  SnapshotRegistry::Instance().Register(snapshot_key_, this);
+
+  // Optional binary recorder of the per step forces, rotors with the same file share one ring buffer.
+  if (!flight_recorder_file_.empty()) {
+    flight_recorder_ = FlightRecorder::Open(flight_recorder_file_, flight_recorder_capacity_);
+    if (!flight_recorder_)
+      gzerr << "[gazebo_motor_model] Couldn't open flight recorder file \"" << flight_recorder_file_
+            << "\": " << strerror(errno) << "\n";
+    memset(&flight_record_, 0, sizeof(flight_record_));
+    flight_record_.motor_number = motor_number_;
+  }
 }
 
 // This gets called by the world update start event.
@@ -170,6 +330,30 @@ void GazeboMotorModel::VelocityCallback(const mav_msgs::ActuatorsConstPtr& rot_v
   ref_motor_rot_vel_ = std::min(rot_velocities->angular_velocities[motor_number_], max_rot_velocity_);
 }
 
+void GazeboMotorModel::MixerThrustCallback(const std_msgs::Float64ConstPtr& msg) {
+  // Thrust is input 3 of the mixer, as in the Pixhawk control group 0.
+  (*mixer_input_)(3) = msg->data;
+  mixer_thrust_received_ = true;
+  UpdateMixedVelocity();
+}
+
+void GazeboMotorModel::MixerAttitudeCallback(const std_msgs::Float64MultiArrayConstPtr& msg) {
+  for (size_t i = 0; i < msg->data.size() && i < mixer_attitude_inputs_.size(); i++) {
+    int input = mixer_attitude_inputs_[i];
+    if (input >= 0 && input < MixerEngine::kMaxInputs)
+      (*mixer_input_)(input) = msg->data[i];
+  }
+  mixer_attitude_received_ = true;
+  UpdateMixedVelocity();
+}
+
+void GazeboMotorModel::UpdateMixedVelocity() {
+  // Same as the mixer nodes, the motors wait for both controllers.
+  if (!mixer_thrust_received_ || !mixer_attitude_received_)
+    return;
+  ref_motor_rot_vel_ = std::min(mixer_->mix(*mixer_input_, motor_number_), max_rot_velocity_);
+}
+
 void GazeboMotorModel::WindSpeedCallback(const rotors_comm::WindSpeedConstPtr& wind_speed) {
   // TODO(burrimi): Transform velocity to world frame if frame_id is set to something else.
   wind_speed_W_.X(wind_speed->velocity.x);
@@ -190,65 +374,56 @@ void GazeboMotorModel::AngleControlFlapValueCallback(const control_msgs::JointCo
 
 
 void GazeboMotorModel::UpdateForcesAndMoments() {	
-  motor_rot_vel_ = joint_->GetVelocity(0);
-  if (motor_rot_vel_ / (2 * M_PI) > 1 / (2 * sampling_time_)) {
-    gzerr << "Aliasing on motor [" << motor_number_ << "] might occur. Consider making smaller simulation time steps or raising the rotor_velocity_slowdown_sim_ param.\n";
+  FidelityLevel level = fidelity_vehicle_ ?
+      static_cast<FidelityLevel>(fidelity_vehicle_->level.load(std::memory_order_relaxed)) : fidelity_level_;
+  if (level == FidelityLevel::Minimal) {
+    UpdateMinimalWrench();
+    return;
   }
-  double real_motor_velocity = motor_rot_vel_ * rotor_velocity_slowdown_sim_;
-  double force = real_motor_velocity * real_motor_velocity * motor_constant_;
-  // Apply a force to the link.
-  //link_->AddRelativeForce(math::Vector3(0, 0, force));
-
 
-  //Ducted fan formulas
-
-  if (motor_number_ == 0 || motor_number_ == 2) { // we assume there is only one control flap wing beneath the rotor
-    flag_x = 1;
-    flag_y = 0;
-  }
-  else if (motor_number_ == 1 || motor_number_ == 3) {
-    flag_x = 0;
-    flag_y = 1;
+  if (kinematic_rotor_) {
+    // Rotor speed is the state of the motor filter, the joint is not read so the step size is not limited by aliasing.
+    motor_rot_vel_ = turning_direction_ * kinematic_rotor_velocity_ / rotor_velocity_slowdown_sim_;
   }
   else {
-    gzerr << "[gazebo_motor_model] Please specify a motorNumber.\n";
+    motor_rot_vel_ = joint_->GetVelocity(0);
+    if (motor_rot_vel_ / (2 * M_PI) > 1 / (2 * sampling_time_)) {
+      gzerr << "Aliasing on motor [" << motor_number_ << "] might occur. Consider making smaller simulation time steps or raising the rotor_velocity_slowdown_sim_ param.\n";
+    }
   }
+  double real_motor_velocity = motor_rot_vel_ * rotor_velocity_slowdown_sim_;
 
-  if (angle_control_flap_ > 0.3 || angle_control_flap_ < -0.3){ // maximum angle value is 15 deg (0.26179 rad)
+  if (flap_servo_) {
+    angle_control_flap_ = flap_servo_->update(angle_control_flap_ref_, sampling_time_);
+  }
+  else if (angle_control_flap_ > 0.3 || angle_control_flap_ < -0.3){ // maximum angle value is 15 deg (0.26179 rad)
   	angle_control_flap_ = 0; // values before the morus_control.launch are large and incorrect and cause problems with forces
   }
 
+  if (level == FidelityLevel::Full)
+    UpdateFullWrench(real_motor_velocity);
+  else
+    UpdateReducedWrench(real_motor_velocity);
 
-  angle_antitorque_flap_ = 0; //antitorque flaps for single rotor vehicles can be added easily, decided not to use them
-  double slip_velocity_squared_ = real_motor_velocity * real_motor_velocity * slip_velocity_coefficient_;
-  
-
-  double force_x_ = fluid_density_ * area_control_flap_ * slip_velocity_squared_ * 
-  lift_coefficient_control_flap_ * angle_control_flap_ * flag_x;
-  double force_y_ = fluid_density_ * area_control_flap_ * slip_velocity_squared_ * 
-  lift_coefficient_control_flap_ * angle_control_flap_ * flag_y;
-  
-  double force_antitorque_flap_ = fluid_density_ * area_antitorque_flap_ * slip_velocity_squared_ * 
-  (drag_coefficient_antitorque_flap_ * angle_antitorque_flap_ * angle_antitorque_flap_ + drag_coefficient_antitorque_flap_at0_);
-  double force_thrust_ = real_motor_velocity * real_motor_velocity * thrust_coefficient_;
-  double force_control_flap_ = fluid_density_ * area_control_flap_ * slip_velocity_squared_ * 
-  (drag_coefficient_control_flap_ * angle_control_flap_ * angle_control_flap_ + drag_coefficient_control_flap_at0_);
-  double force_z_ = force_thrust_ - force_antitorque_flap_ - force_control_flap_;
-
-  
-  double moment_x_ = force_x_ * distance_control_flap_ ;
-  double moment_y_ = force_y_ * distance_control_flap_ ;
-  double moment_z_1 = - turning_direction_ * torque_coefficient_ * force_thrust_;
-  double moment_z_2 = fluid_density_ * area_antitorque_flap_ * slip_velocity_squared_*
-  (lift_coefficient_antitorque_flap_ * angle_antitorque_flap_ + lift_coefficient_antitorque_flap_at0_);
-  double moment_z_ = - turning_direction_ * torque_coefficient_ * force_thrust_ + fluid_density_ * area_antitorque_flap_ * slip_velocity_squared_* 
-  (lift_coefficient_antitorque_flap_ * angle_antitorque_flap_ + lift_coefficient_antitorque_flap_at0_);
-  //decided that the antitorque part of the formulas is not used
-
-  link_->AddForce(ignition::math::Vector3<double>(force_x_, force_y_, force_z_));
-
+  // Apply the filter on the motor's velocity.
+  double ref_motor_rot_vel;
+  ref_motor_rot_vel = rotor_velocity_filter_->updateFilter(ref_motor_rot_vel_, sampling_time_);
+  kinematic_rotor_velocity_ = ref_motor_rot_vel;
+  // In kinematic mode spinning the joint is only cosmetic and can be turned off.
+  if (!kinematic_rotor_ || visual_rotor_spin_)
+    joint_->SetVelocity(0, turning_direction_ * ref_motor_rot_vel / rotor_velocity_slowdown_sim_);
+}
 
+void GazeboMotorModel::UpdateFullWrench(double real_motor_velocity) {
+  //Ducted fan formulas, see DuctedFanRotorGeometry
+  double slip_velocity_squared = real_motor_velocity * real_motor_velocity * slip_velocity_coefficient_;
+  double force_thrust = real_motor_velocity * real_motor_velocity * thrust_coefficient_;
+  double flap_lift = slip_velocity_squared * angle_control_flap_;
 
+  ignition::math::Vector3d force = flap_lift * geometry_.flap_force;
+  force.Z(force.Z() + force_thrust - slip_velocity_squared *
+          (geometry_.drag_at0 + geometry_.drag_flap * angle_control_flap_ * angle_control_flap_));
+  link_->AddForce(force);
 
   // Forces from Philppe Martin's and Erwan Salaün's
   // 2010 IEEE Conference on Robotics and Automation paper
@@ -262,49 +437,81 @@ void GazeboMotorModel::UpdateForcesAndMoments() {
   // Apply air_drag to link.
   link_->AddForce(air_drag);
   // Moments
-  // Getting the parent link, such that the resulting torques can be applied to it.
-  physics::Link_V parent_links = link_->GetParentJointsLinks();
   // The tansformation from the parent_link to the link_.
-  ignition::math::Pose3<double> pose_difference = link_->WorldCoGPose() - parent_links.at(0)->WorldCoGPose();
+  ignition::math::Pose3<double> pose_difference = link_->WorldCoGPose() - parent_link_->WorldCoGPose();
 
 
-  ignition::math::Vector3<double> drag_torque(moment_x_, moment_y_, moment_z_1);
-
+  ignition::math::Vector3<double> drag_torque = flap_lift * geometry_.flap_moment;
+  drag_torque.Z(drag_torque.Z() + geometry_.yaw_moment * force_thrust);
 
   // Transforming the drag torque into the parent frame to handle arbitrary rotor orientations.
   ignition::math::Vector3<double> drag_torque_parent_frame = pose_difference.Rot().RotateVector(drag_torque);
-  parent_links.at(0)->AddRelativeTorque(drag_torque_parent_frame);
+  parent_link_->AddRelativeTorque(drag_torque_parent_frame);
 
   ignition::math::Vector3<double> rolling_moment;
   // - \omega * \mu_1 * V_A^{\perp}
   rolling_moment = -std::abs(real_motor_velocity) * rolling_moment_coefficient_ * body_velocity_perpendicular;
-  parent_links.at(0)->AddTorque(rolling_moment);
-  // Apply the filter on the motor's velocity.
-  double ref_motor_rot_vel;
-  ref_motor_rot_vel = rotor_velocity_filter_->updateFilter(ref_motor_rot_vel_, sampling_time_);
-  joint_->SetVelocity(0, turning_direction_ * ref_motor_rot_vel / rotor_velocity_slowdown_sim_);
+  parent_link_->AddTorque(rolling_moment);
 
-  
-  //std::cout << "angle_control_flap_2 " << angle_control_flap_ << std::endl;
-  //std::cout << "angle_control_flap_sub_topic_" << angle_control_flap_sub_topic_ << std::endl; 
-
-  //std::cout << "motor_number_ " << motor_number_ << std::endl;
-  //std::cout << "force " << force << std::endl;
-  /*std::cout << "force_x_ " << force_x_ << std::endl; 
-  std::cout << "force_y_ " << force_y_ << std::endl;
-  std::cout << "force_z_ " << force_z_ << std::endl;
-  std::cout << "slip_velocity_squared_ " << slip_velocity_squared_ << std::endl;
-  std::cout << "force_thrust_" << force_thrust_ << std::endl;
-  std::cout << "force_control_flap_ " << force_control_flap_ << std::endl;
-  std::cout << "force_antitorque_flap_ " << force_antitorque_flap_ << std::endl;
-
-  std::cout << "drag_torque " << drag_torque << std::endl;
-  std::cout << "rolling_moment " << rolling_moment << std::endl;
-  std::cout << "moment_x_ " << moment_x_ << std::endl;
-  std::cout << "moment_y_ " << moment_y_ << std::endl;
-  std::cout << "moment_z_ " << moment_z_ << std::endl;
-  std::cout << "moment_z_1 " << moment_z_1 << std::endl;
-  std::cout << "moment_z_2 " << moment_z_2 << std::endl << std::endl;*/
+  WriteFlightRecord(real_motor_velocity, force, drag_torque, air_drag, rolling_moment);
+}
+
+// Thrust and yaw torque only, the flaps, rotor drag and rolling moment are left out.
+void GazeboMotorModel::UpdateReducedWrench(double real_motor_velocity) {
+  double force_thrust = real_motor_velocity * real_motor_velocity * thrust_coefficient_;
+  ignition::math::Vector3d force(0, 0, force_thrust);
+  link_->AddForce(force);
+
+  ignition::math::Pose3d pose_difference = link_->WorldCoGPose() - parent_link_->WorldCoGPose();
+  ignition::math::Vector3d drag_torque(0, 0, geometry_.yaw_moment * force_thrust);
+  parent_link_->AddRelativeTorque(pose_difference.Rot().RotateVector(drag_torque));
+
+  WriteFlightRecord(real_motor_velocity, force, drag_torque, ignition::math::Vector3d::Zero,
+                    ignition::math::Vector3d::Zero);
+}
+
+// The rotor runs at its command without motor dynamics. Thrust and yaw torque depend on the
+// command only, so they are computed when it changes and applied as they are in between.
+void GazeboMotorModel::UpdateMinimalWrench() {
+  double real_motor_velocity = ref_motor_rot_vel_;
+  if (real_motor_velocity != minimal_command_) {
+    double force_thrust = real_motor_velocity * real_motor_velocity * thrust_coefficient_;
+    ignition::math::Pose3d pose_difference = link_->WorldCoGPose() - parent_link_->WorldCoGPose();
+    minimal_force_.Set(0, 0, force_thrust);
+    minimal_torque_ = pose_difference.Rot().RotateVector(
+        ignition::math::Vector3d(0, 0, geometry_.yaw_moment * force_thrust));
+    minimal_command_ = real_motor_velocity;
+  }
+  link_->AddForce(minimal_force_);
+  parent_link_->AddRelativeTorque(minimal_torque_);
+
+  // Keep the motor state at the command, so a switch back to the other levels is seamless.
+  motor_rot_vel_ = turning_direction_ * real_motor_velocity / rotor_velocity_slowdown_sim_;
+  kinematic_rotor_velocity_ = real_motor_velocity;
+  rotor_velocity_filter_->setState(real_motor_velocity);
+  if (!kinematic_rotor_ || visual_rotor_spin_)
+    joint_->SetVelocity(0, motor_rot_vel_);
+
+  WriteFlightRecord(real_motor_velocity, minimal_force_, minimal_torque_, ignition::math::Vector3d::Zero,
+                    ignition::math::Vector3d::Zero);
+}
+
+void GazeboMotorModel::WriteFlightRecord(double real_motor_velocity, const ignition::math::Vector3d& force,
+                                         const ignition::math::Vector3d& moment,
+                                         const ignition::math::Vector3d& drag,
+                                         const ignition::math::Vector3d& rolling_moment) {
+  if (!flight_recorder_)
+    return;
+  flight_record_.sim_time = prev_sim_time_;
+  flight_record_.rotor_velocity = real_motor_velocity;
+  flight_record_.flap_angle = angle_control_flap_;
+  for (int i = 0; i < 3; i++) {
+    flight_record_.force[i] = force[i];
+    flight_record_.moment[i] = moment[i];
+    flight_record_.drag[i] = drag[i];
+    flight_record_.rolling_moment[i] = rolling_moment[i];
+  }
+  flight_recorder_->Write(flight_record_);
 }
 
 GZ_REGISTER_MODEL_PLUGIN(GazeboMotorModel);
@@ -0,0 +1,226 @@
+#include "mmuav_plugins/gazebo_mass_center_estimator.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+namespace gazebo {
+
+GazeboMassCenterEstimator::~GazeboMassCenterEstimator() {
+  updateConnection_.reset();
+  if (!snapshot_key_.empty())
+    SnapshotRegistry::Instance().Unregister(snapshot_key_);
+  if (node_handle_) {
+    node_handle_->shutdown();
+    delete node_handle_;
+  }
+}
+
+void GazeboMassCenterEstimator::SaveSnapshot(std::ostream& out) const {
+  writeSnapshotValue<uint32_t>(out, kMassCenterSnapshotVersion);
+  writeSnapshotValue(out, prev_publish_time_);
+}
+
+bool GazeboMassCenterEstimator::RestoreSnapshot(std::istream& in) {
+  uint32_t version;
+  if (!readSnapshotValue(in, version) || version != kMassCenterSnapshotVersion) {
+    gzerr << "[gazebo_mass_center_estimator] Unsupported snapshot of model [" << model_->GetName() << "].\n";
+    return false;
+  }
+  if (!readSnapshotValue(in, prev_publish_time_)) {
+    gzerr << "[gazebo_mass_center_estimator] Truncated snapshot of model [" << model_->GetName() << "].\n";
+    return false;
+  }
+
+  // The links were moved by the restore, sum them again on the next step.
+  steps_since_resync_ = -1;
+  return true;
+}
+
+void GazeboMassCenterEstimator::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
+  model_ = _model;
+
+  getSdfParam<std::string>(_sdf, "robotNamespace", namespace_, namespace_);
+  node_handle_ = new ros::NodeHandle(namespace_);
+
+  std::string joint_names;
+  getSdfParam<std::string>(_sdf, "baseLinkName", base_link_name_, base_link_name_);
+  getSdfParam<std::string>(_sdf, "jointNames", joint_names, kDefaultMassCenterJointNames);
+  getSdfParam<std::string>(_sdf, "inertiaPubTopic", pub_topic_, pub_topic_);
+  getSdfParam<std::string>(_sdf, "sharedMemoryFile", shared_memory_file_, shared_memory_file_);
+  getSdfParam<double>(_sdf, "updateRate", update_rate_, update_rate_);
+  getSdfParam<double>(_sdf, "jointTolerance", joint_tolerance_, joint_tolerance_);
+  getSdfParam<int>(_sdf, "resyncInterval", resync_interval_, resync_interval_);
+
+  base_link_ = model_->GetLink(base_link_name_);
+  if (base_link_ == NULL)
+    gzthrow("[gazebo_mass_center_estimator] Couldn't find specified link \"" << base_link_name_ << "\".");
+
+  std::map<physics::Link*, int> link_index;
+  for (const physics::LinkPtr& link : model_->GetLinks()) {
+    ignition::math::Matrix3d moi = link->GetInertial()->MOI();
+    LinkMass entry;
+    entry.link = link;
+    entry.mass = link->GetInertial()->Mass();
+    for (int row = 0; row < 3; row++)
+      for (int col = 0; col < 3; col++)
+        entry.moment_of_inertia(row, col) = moi(row, col);
+    entry.first_moment.setZero();
+    entry.inertia.setZero();
+    link_index[link.get()] = links_.size();
+    links_.push_back(entry);
+  }
+  dirty_.assign(links_.size(), 0);
+  updated_.reserve(links_.size());
+
+  // Every link below a joint moves with it, nested joints (the arms) share links.
+  std::istringstream names(joint_names);
+  for (std::string name; names >> name;) {
+    MovingJoint moving;
+    moving.joint = model_->GetJoint(name);
+    if (moving.joint == NULL)
+      gzthrow("[gazebo_mass_center_estimator] Couldn't find specified joint \"" << name << "\".");
+    moving.position = 0.0;
+
+    std::vector<char> visited(links_.size(), 0);
+    std::vector<physics::LinkPtr> stack(1, moving.joint->GetChild());
+    while (!stack.empty()) {
+      physics::LinkPtr link = stack.back();
+      stack.pop_back();
+      auto it = link ? link_index.find(link.get()) : link_index.end();
+      if (it == link_index.end() || visited[it->second])
+        continue;
+      visited[it->second] = 1;
+      moving.links.push_back(it->second);
+      for (const physics::JointPtr& child : link->GetChildJoints())
+        stack.push_back(child->GetChild());
+    }
+    joints_.push_back(moving);
+  }
+
+  if (!shared_memory_file_.empty()) {
+    shared_memory_ = MassPropertiesShm::Create(shared_memory_file_);
+    if (!shared_memory_)
+      gzerr << "[gazebo_mass_center_estimator] Couldn't create shared memory file \"" << shared_memory_file_
+            << "\": " << strerror(errno) << "\n";
+  }
+
+  inertia_pub_ = node_handle_->advertise<geometry_msgs::InertiaStamped>(pub_topic_, 1);
+  inertia_msg_.header.frame_id = base_link_name_;
+
+  // Listen to the update event. This event is broadcast every
+  // simulation iteration.
+  updateConnection_ = event::Events::ConnectWorldUpdateBegin(boost::bind(&GazeboMassCenterEstimator::OnUpdate, this, _1));
+
+  // Make the internal state available to the scenario snapshot world plugin.
+  snapshot_key_ = model_->GetScopedName() + "::mass_center_estimator";
+  SnapshotRegistry::Instance().Register(snapshot_key_, this);
+}
+
+// This gets called by the world update start event.
+void GazeboMassCenterEstimator::OnUpdate(const common::UpdateInfo& _info) {
+  ignition::math::Pose3d base_pose = base_link_->WorldPose();
+
+  if (steps_since_resync_ < 0 || steps_since_resync_ >= resync_interval_) {
+    Resync(base_pose);
+  }
+  else {
+    steps_since_resync_++;
+    for (MovingJoint& moving : joints_) {
+      double position = moving.joint->Position(0);
+      if (std::abs(position - moving.position) <= joint_tolerance_)
+        continue;
+      moving.position = position;
+      for (int index : moving.links) {
+        if (dirty_[index])
+          continue;
+        dirty_[index] = 1;
+        updated_.push_back(index);
+        UpdateContribution(links_[index], base_pose);
+      }
+    }
+    for (int index : updated_)
+      dirty_[index] = 0;
+    updated_.clear();
+  }
+
+  ComputeProperties(_info.simTime.Double());
+  if (shared_memory_)
+    shared_memory_->Write(properties_);
+
+  if (update_rate_ > 0.0 && _info.simTime.Double() - prev_publish_time_ < 1.0 / update_rate_)
+    return;
+  prev_publish_time_ = _info.simTime.Double();
+  Publish();
+}
+
+// Sums the whole model from scratch.
+void GazeboMassCenterEstimator::Resync(const ignition::math::Pose3d& base_pose) {
+  mass_ = 0.0;
+  first_moment_.setZero();
+  inertia_.setZero();
+  for (LinkMass& link : links_) {
+    link.first_moment.setZero();
+    link.inertia.setZero();
+    mass_ += link.mass;
+    UpdateContribution(link, base_pose);
+  }
+  for (MovingJoint& moving : joints_)
+    moving.position = moving.joint->Position(0);
+  steps_since_resync_ = 0;
+}
+
+// Replaces the contribution of one link to the sums with the one at its current pose.
+void GazeboMassCenterEstimator::UpdateContribution(LinkMass& link, const ignition::math::Pose3d& base_pose) {
+  ignition::math::Pose3d pose = link.link->WorldCoGPose() - base_pose;
+  Eigen::Matrix3d rotation = Eigen::Quaterniond(pose.Rot().W(), pose.Rot().X(), pose.Rot().Y(),
+                                                pose.Rot().Z()).toRotationMatrix();
+  Eigen::Vector3d position(pose.Pos().X(), pose.Pos().Y(), pose.Pos().Z());
+
+  // Inertia about the base origin by the parallel axis theorem.
+  Eigen::Vector3d first_moment = link.mass * position;
+  Eigen::Matrix3d inertia = rotation * link.moment_of_inertia * rotation.transpose() +
+      link.mass * (position.squaredNorm() * Eigen::Matrix3d::Identity() - position * position.transpose());
+
+  first_moment_ += first_moment - link.first_moment;
+  inertia_ += inertia - link.inertia;
+  link.first_moment = first_moment;
+  link.inertia = inertia;
+}
+
+void GazeboMassCenterEstimator::ComputeProperties(double sim_time) {
+  Eigen::Vector3d com = mass_ > 0.0 ? Eigen::Vector3d(first_moment_ / mass_) : Eigen::Vector3d::Zero();
+  // Back from the base origin to the centre of mass.
+  Eigen::Matrix3d inertia = inertia_ - mass_ * (com.squaredNorm() * Eigen::Matrix3d::Identity() - com * com.transpose());
+
+  properties_.sim_time = sim_time;
+  properties_.mass = mass_;
+  for (int i = 0; i < 3; i++)
+    properties_.com[i] = com(i);
+  properties_.inertia[0] = inertia(0, 0);
+  properties_.inertia[1] = inertia(0, 1);
+  properties_.inertia[2] = inertia(0, 2);
+  properties_.inertia[3] = inertia(1, 1);
+  properties_.inertia[4] = inertia(1, 2);
+  properties_.inertia[5] = inertia(2, 2);
+}
+
+void GazeboMassCenterEstimator::Publish() {
+  inertia_msg_.header.stamp.fromSec(properties_.sim_time);
+  inertia_msg_.inertia.m = properties_.mass;
+  inertia_msg_.inertia.com.x = properties_.com[0];
+  inertia_msg_.inertia.com.y = properties_.com[1];
+  inertia_msg_.inertia.com.z = properties_.com[2];
+  inertia_msg_.inertia.ixx = properties_.inertia[0];
+  inertia_msg_.inertia.ixy = properties_.inertia[1];
+  inertia_msg_.inertia.ixz = properties_.inertia[2];
+  inertia_msg_.inertia.iyy = properties_.inertia[3];
+  inertia_msg_.inertia.iyz = properties_.inertia[4];
+  inertia_msg_.inertia.izz = properties_.inertia[5];
+  inertia_pub_.publish(inertia_msg_);
+}
+
+GZ_REGISTER_MODEL_PLUGIN(GazeboMassCenterEstimator);
+}
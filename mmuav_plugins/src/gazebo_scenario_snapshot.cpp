@@ -0,0 +1,221 @@
+#include "mmuav_plugins/gazebo_scenario_snapshot.h"
+
+#include <chrono>
+#include <fstream>
+#include <stdint.h>
+
+namespace gazebo {
+
+static const char kSnapshotMagic[8] = {'M', 'M', 'U', 'A', 'V', 'S', 'S', '1'};
+
+namespace {
+void writePose(std::ostream& out, const ignition::math::Pose3d& pose) {
+  double values[7] = {pose.Pos().X(), pose.Pos().Y(), pose.Pos().Z(),
+                      pose.Rot().W(), pose.Rot().X(), pose.Rot().Y(), pose.Rot().Z()};
+  writeSnapshotValue(out, values);
+}
+
+bool readPose(std::istream& in, ignition::math::Pose3d& pose) {
+  double values[7];
+  if (!readSnapshotValue(in, values))
+    return false;
+  pose.Set(ignition::math::Vector3d(values[0], values[1], values[2]),
+           ignition::math::Quaterniond(values[3], values[4], values[5], values[6]));
+  return true;
+}
+
+void writeVector(std::ostream& out, const ignition::math::Vector3d& vector) {
+  double values[3] = {vector.X(), vector.Y(), vector.Z()};
+  writeSnapshotValue(out, values);
+}
+
+bool readVector(std::istream& in, ignition::math::Vector3d& vector) {
+  double values[3];
+  if (!readSnapshotValue(in, values))
+    return false;
+  vector.Set(values[0], values[1], values[2]);
+  return true;
+}
+}
+
+GazeboScenarioSnapshot::~GazeboScenarioSnapshot() {
+  updateConnection_.reset();
+  if (node_handle_) {
+    node_handle_->shutdown();
+    delete node_handle_;
+  }
+}
+
+void GazeboScenarioSnapshot::Load(physics::WorldPtr _world, sdf::ElementPtr _sdf) {
+  world_ = _world;
+
+  getSdfParam<std::string>(_sdf, "robotNamespace", namespace_, namespace_);
+  getSdfParam<std::string>(_sdf, "snapshotFile", snapshot_file_, snapshot_file_);
+  getSdfParam<double>(_sdf, "timeout", timeout_, timeout_);
+  node_handle_ = new ros::NodeHandle(namespace_);
+
+  // Snapshots are taken and restored after the physics update, between two steps.
+  updateConnection_ = event::Events::ConnectWorldUpdateEnd(boost::bind(&GazeboScenarioSnapshot::OnUpdateEnd, this));
+
+  save_service_ = node_handle_->advertiseService("save", &GazeboScenarioSnapshot::SaveCallback, this);
+  restore_service_ = node_handle_->advertiseService("restore", &GazeboScenarioSnapshot::RestoreCallback, this);
+}
+
+void GazeboScenarioSnapshot::OnUpdateEnd() {
+  std::lock_guard<std::mutex> lock(request_mutex_);
+  if (pending_request_ == kNone)
+    return;
+
+  if (pending_request_ == kSave)
+    request_result_ = Save(request_file_, request_message_);
+  else
+    request_result_ = Restore(request_file_, request_message_);
+  pending_request_ = kNone;
+  request_done_.notify_all();
+}
+
+bool GazeboScenarioSnapshot::SaveCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res) {
+  res.success = Execute(kSave, res.message);
+  return true;
+}
+
+bool GazeboScenarioSnapshot::RestoreCallback(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res) {
+  res.success = Execute(kRestore, res.message);
+  return true;
+}
+
+bool GazeboScenarioSnapshot::Execute(Request request, std::string& message) {
+  std::string path;
+  node_handle_->param<std::string>("file", path, snapshot_file_);
+
+  std::unique_lock<std::mutex> lock(request_mutex_);
+  // While paused there is no update to hand the request to, and nothing is stepping either.
+  if (world_->IsPaused())
+    return request == kSave ? Save(path, message) : Restore(path, message);
+
+  std::chrono::duration<double> timeout(timeout_);
+  if (!request_done_.wait_for(lock, timeout, [this] { return pending_request_ == kNone; })) {
+    message = "Another snapshot request is still pending.";
+    return false;
+  }
+  pending_request_ = request;
+  request_file_ = path;
+  if (!request_done_.wait_for(lock, timeout, [this] { return pending_request_ == kNone; })) {
+    pending_request_ = kNone;
+    message = "Timed out waiting for the world update.";
+    return false;
+  }
+  message = request_message_;
+  return request_result_;
+}
+
+bool GazeboScenarioSnapshot::Save(const std::string& path, std::string& message) {
+  std::ofstream out(path.c_str(), std::ios::binary);
+  if (!out) {
+    message = "Couldn't open \"" + path + "\" for writing.";
+    return false;
+  }
+
+  out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+  writeSnapshotValue(out, world_->SimTime().Double());
+
+  physics::Model_V models = world_->Models();
+  uint32_t dynamic_models = 0;
+  for (size_t i = 0; i < models.size(); i++)
+    if (!models[i]->IsStatic())
+      dynamic_models++;
+
+  writeSnapshotValue(out, dynamic_models);
+  for (size_t i = 0; i < models.size(); i++) {
+    if (models[i]->IsStatic())
+      continue;
+    writeSnapshotString(out, models[i]->GetName());
+    physics::Link_V links = models[i]->GetLinks();
+    writeSnapshotValue<uint32_t>(out, links.size());
+    for (size_t j = 0; j < links.size(); j++) {
+      writeSnapshotString(out, links[j]->GetName());
+      writePose(out, links[j]->WorldPose());
+      writeVector(out, links[j]->WorldLinearVel());
+      writeVector(out, links[j]->WorldAngularVel());
+    }
+  }
+
+  SnapshotRegistry::Instance().Save(out);
+
+  if (!out) {
+    message = "Couldn't write snapshot to \"" + path + "\".";
+    return false;
+  }
+  message = "Saved " + std::to_string(dynamic_models) + " models at t=" +
+      std::to_string(world_->SimTime().Double()) + " to " + path;
+  return true;
+}
+
+bool GazeboScenarioSnapshot::Restore(const std::string& path, std::string& message) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in) {
+    message = "Couldn't open \"" + path + "\".";
+    return false;
+  }
+
+  char magic[sizeof(kSnapshotMagic)];
+  in.read(magic, sizeof(magic));
+  if (!in || std::string(magic, sizeof(magic)) != std::string(kSnapshotMagic, sizeof(kSnapshotMagic))) {
+    message = "\"" + path + "\" is not a scenario snapshot.";
+    return false;
+  }
+
+  double sim_time;
+  uint32_t model_count;
+  if (!readSnapshotValue(in, sim_time) || !readSnapshotValue(in, model_count)) {
+    message = "Snapshot is truncated.";
+    return false;
+  }
+
+  std::string model_name, link_name;
+  ignition::math::Pose3d pose;
+  ignition::math::Vector3d linear_velocity, angular_velocity;
+  for (uint32_t i = 0; i < model_count; i++) {
+    uint32_t link_count;
+    if (!readSnapshotString(in, model_name) || !readSnapshotValue(in, link_count)) {
+      message = "Snapshot is truncated.";
+      return false;
+    }
+    physics::ModelPtr model = world_->ModelByName(model_name);
+    if (!model)
+      gzwarn << "[gazebo_scenario_snapshot] Model \"" << model_name << "\" from the snapshot is not in the world.\n";
+
+    for (uint32_t j = 0; j < link_count; j++) {
+      if (!readSnapshotString(in, link_name) || !readPose(in, pose) || !readVector(in, linear_velocity) ||
+          !readVector(in, angular_velocity)) {
+        message = "Snapshot is truncated.";
+        return false;
+      }
+      physics::LinkPtr link = model ? model->GetLink(link_name) : physics::LinkPtr();
+      if (!link)
+        continue;
+      link->SetWorldPose(pose);
+      link->SetLinearVel(linear_velocity);
+      link->SetAngularVel(angular_velocity);
+    }
+  }
+
+  // Time jumping back kills rospy nodes that sleep on a rospy.Rate, see the class comment.
+  if (sim_time < world_->SimTime().Double())
+    gzwarn << "[gazebo_scenario_snapshot] Sim time moves back to t=" << sim_time
+           << ", restart the rospy controllers.\n";
+  world_->SetSimTime(common::Time(sim_time));
+
+  int plugins = SnapshotRegistry::Instance().Restore(in);
+  if (plugins < 0) {
+    message = "Plugin state in the snapshot is malformed.";
+    return false;
+  }
+
+  message = "Restored " + std::to_string(model_count) + " models and " + std::to_string(plugins) +
+      " plugins at t=" + std::to_string(sim_time) + " from " + path;
+  return true;
+}
+
+GZ_REGISTER_WORLD_PLUGIN(GazeboScenarioSnapshot);
+}
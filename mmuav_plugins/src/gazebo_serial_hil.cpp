@@ -0,0 +1,176 @@
+#include "mmuav_plugins/gazebo_serial_hil.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace gazebo {
+
+GazeboSerialHil::~GazeboSerialHil() {
+  updateConnection_.reset();
+  if (!snapshot_key_.empty())
+    SnapshotRegistry::Instance().Unregister(snapshot_key_);
+  link_.Close();
+  if (node_handle_) {
+    node_handle_->shutdown();
+    delete node_handle_;
+  }
+}
+
+void GazeboSerialHil::SaveSnapshot(std::ostream& out) const {
+  writeSnapshotValue<uint32_t>(out, kSerialHilSnapshotVersion);
+  writeSnapshotValue(out, prev_sim_time_);
+  writeSnapshotValue(out, prev_frame_time_);
+  writeSnapshotValue(out, readback_received_);
+  std::lock_guard<std::mutex> lock(command_mutex_);
+  for (size_t i = 0; i < kSerialFrameValues; i++) {
+    writeSnapshotValue(out, command_[i]);
+    writeSnapshotValue(out, target_[i]);
+  }
+}
+
+bool GazeboSerialHil::RestoreSnapshot(std::istream& in) {
+  uint32_t version;
+  if (!readSnapshotValue(in, version) || version != kSerialHilSnapshotVersion) {
+    gzerr << "[gazebo_serial_hil] Unsupported snapshot of \"" << device_ << "\".\n";
+    return false;
+  }
+  bool ok = readSnapshotValue(in, prev_sim_time_) && readSnapshotValue(in, prev_frame_time_) &&
+      readSnapshotValue(in, readback_received_);
+  std::lock_guard<std::mutex> lock(command_mutex_);
+  for (size_t i = 0; ok && i < kSerialFrameValues; i++)
+    ok = readSnapshotValue(in, command_[i]) && readSnapshotValue(in, target_[i]);
+  if (!ok) {
+    gzerr << "[gazebo_serial_hil] Truncated snapshot of \"" << device_ << "\".\n";
+    return false;
+  }
+
+  for (common::PID& pid : pids_)
+    pid.Reset();
+  return true;
+}
+
+void GazeboSerialHil::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
+  model_ = _model;
+
+  getSdfParam<std::string>(_sdf, "robotNamespace", namespace_, namespace_);
+  node_handle_ = new ros::NodeHandle(namespace_);
+
+  std::string joint_names, stepper_parameters;
+  double p, i, d, i_clamp;
+  getSdfParam<std::string>(_sdf, "device", device_, device_);
+  getSdfParam<int>(_sdf, "baudrate", baudrate_, baudrate_);
+  getSdfParam<std::string>(_sdf, "commandSubTopic", command_sub_topic_, command_sub_topic_);
+  getSdfParam<std::string>(_sdf, "readbackPubTopic", readback_pub_topic_, readback_pub_topic_);
+  getSdfParam<std::string>(_sdf, "jointNames", joint_names, kDefaultSerialHilJointNames);
+  getSdfParam<std::string>(_sdf, "stepperParameters", stepper_parameters, "");
+  getSdfParam<double>(_sdf, "updateRate", update_rate_, update_rate_);
+  getSdfParam<double>(_sdf, "readbackTimeout", readback_timeout_, readback_timeout_);
+  getSdfParam<double>(_sdf, "massScaler", mass_scaler_, mass_scaler_);
+  getSdfParam<double>(_sdf, "maxMassPosition", max_mass_position_, max_mass_position_);
+  getSdfParam<double>(_sdf, "p", p, kDefaultSerialHilP);
+  getSdfParam<double>(_sdf, "i", i, kDefaultSerialHilI);
+  getSdfParam<double>(_sdf, "d", d, kDefaultSerialHilD);
+  getSdfParam<double>(_sdf, "iClamp", i_clamp, kDefaultSerialHilIClamp);
+
+  std::istringstream names(joint_names);
+  for (std::string name; names >> name;) {
+    physics::JointPtr joint = model_->GetJoint(name);
+    if (joint == NULL)
+      gzthrow("[gazebo_serial_hil] Couldn't find specified joint \"" << name << "\".");
+    joints_.push_back(joint);
+    pids_.push_back(common::PID(p, i, d, i_clamp, -i_clamp));
+  }
+  if (joints_.size() > kSerialFrameValues)
+    gzthrow("[gazebo_serial_hil] A frame carries at most " << kSerialFrameValues << " masses.");
+  std::fill(command_, command_ + kSerialFrameValues, 0.0);
+  std::fill(target_, target_ + kSerialFrameValues, 0.0);
+
+  if (device_ == "pty") {
+    if (!link_.OpenPty())
+      gzthrow("[gazebo_serial_hil] Couldn't open a pty: " << link_.Error());
+    gzmsg << "[gazebo_serial_hil] Board stand-in can connect to " << link_.SlaveName() << "\n";
+    node_handle_->setParam("serial_hil_device", link_.SlaveName());
+  }
+  else if (!link_.Open(device_, baudrate_)) {
+    gzthrow("[gazebo_serial_hil] Couldn't open \"" << device_ << "\": " << link_.Error());
+  }
+
+  // Board parameters, as set by the dynamic reconfigure server of the bridge.
+  std::istringstream parameters(stepper_parameters);
+  SerialFrame parameter_frame;
+  parameter_frame.terminator = kSerialParameterTerminator;
+  size_t count = 0;
+  while (count < kSerialFrameValues && parameters >> parameter_frame.values[count])
+    count++;
+  if (count == kSerialFrameValues)
+    link_.Write(parameter_frame);
+  else if (count > 0)
+    gzerr << "[gazebo_serial_hil] stepperParameters needs gain, speed, acceleration and deadzone.\n";
+
+  readback_msg_.data.resize(joints_.size());
+  command_sub_ = node_handle_->subscribe(command_sub_topic_, 1, &GazeboSerialHil::CommandCallback, this);
+  readback_pub_ = node_handle_->advertise<std_msgs::Float64MultiArray>(readback_pub_topic_, 1);
+
+  updateConnection_ = event::Events::ConnectWorldUpdateBegin(boost::bind(&GazeboSerialHil::OnUpdate, this, _1));
+
+  // Make the internal state available to the scenario snapshot world plugin.
+  snapshot_key_ = model_->GetScopedName() + "::serial_hil";
+  SnapshotRegistry::Instance().Register(snapshot_key_, this);
+}
+
+void GazeboSerialHil::OnUpdate(const common::UpdateInfo& _info) {
+  double now = _info.simTime.Double();
+  double dt = now - prev_sim_time_;
+  prev_sim_time_ = now;
+
+  // Frames go out on physics step boundaries, so the exchange is tied to sim time.
+  if (prev_frame_time_ < 0.0 || update_rate_ <= 0.0 || now - prev_frame_time_ >= 1.0 / update_rate_ - 1e-9) {
+    prev_frame_time_ = now;
+    ExchangeFrames();
+  }
+
+  if (dt <= 0.0)
+    return;
+  for (size_t i = 0; i < joints_.size(); i++) {
+    double force = pids_[i].Update(joints_[i]->Position(0) - target_[i], common::Time(dt));
+    joints_[i]->SetForce(0, force);
+  }
+}
+
+void GazeboSerialHil::ExchangeFrames() {
+  SerialFrame frame;
+  frame.terminator = kSerialMassCommandTerminator;
+  {
+    std::lock_guard<std::mutex> lock(command_mutex_);
+    for (size_t i = 0; i < kSerialFrameValues; i++) {
+      double position = std::max(-max_mass_position_, std::min(command_[i], max_mass_position_));
+      frame.values[i] = static_cast<int>(mass_scaler_ * position);
+      if (!readback_received_)
+        target_[i] = position;
+    }
+  }
+
+  if (!link_.Write(frame) && !link_error_reported_) {
+    gzerr << "[gazebo_serial_hil] Couldn't write to \"" << device_ << "\": " << link_.Error() << "\n";
+    link_error_reported_ = true;
+  }
+
+  SerialFrame readback;
+  if (!link_.Read(kSerialMassReadbackTerminator, readback_timeout_, readback))
+    return;
+  readback_received_ = true;
+  for (size_t i = 0; i < joints_.size(); i++) {
+    target_[i] = readback.values[i] / mass_scaler_;
+    readback_msg_.data[i] = target_[i];
+  }
+  readback_pub_.publish(readback_msg_);
+}
+
+void GazeboSerialHil::CommandCallback(const std_msgs::Float64MultiArrayConstPtr& msg) {
+  std::lock_guard<std::mutex> lock(command_mutex_);
+  for (size_t i = 0; i < msg->data.size() && i < kSerialFrameValues; i++)
+    command_[i] = msg->data[i];
+}
+
+GZ_REGISTER_MODEL_PLUGIN(GazeboSerialHil);
+}
@@ -0,0 +1,267 @@
+#include "mmuav_plugins/gazebo_variable_pitch_motor_model.h"
+#include <cmath>
+#include <map>
+#include <mutex>
+
+namespace gazebo {
+
+namespace {
+// Tables are shared between all rotors (and vehicles) that use the same table file.
+std::mutex table_cache_mutex;
+std::map<std::string, std::weak_ptr<const RotorPerformanceTable>> table_cache;
+}
+
+GazeboVariablePitchMotorModel::~GazeboVariablePitchMotorModel() {
+  updateConnection_.reset();
+  if (!snapshot_key_.empty())
+    SnapshotRegistry::Instance().Unregister(snapshot_key_);
+  if (node_handle_) {
+    node_handle_->shutdown();
+    delete node_handle_;
+  }
+}
+
+void GazeboVariablePitchMotorModel::InitializeParams() {}
+
+void GazeboVariablePitchMotorModel::SaveSnapshot(std::ostream& out) const {
+  writeSnapshotValue<uint32_t>(out, kVariablePitchSnapshotVersion);
+  writeSnapshotValue(out, prev_sim_time_);
+  writeSnapshotValue(out, sampling_time_);
+  writeSnapshotValue(out, motor_rot_vel_);
+  writeSnapshotValue(out, ref_motor_rot_vel_);
+  writeSnapshotValue(out, rotor_velocity_filter_->getState());
+  writeSnapshotValue(out, ref_pitch_);
+  writeSnapshotValue(out, pitch_);
+  writeSnapshotValue(out, pitch_filter_->getState());
+  writeSnapshotValue(out, wind_speed_W_.X());
+  writeSnapshotValue(out, wind_speed_W_.Y());
+  writeSnapshotValue(out, wind_speed_W_.Z());
+}
+
+bool GazeboVariablePitchMotorModel::RestoreSnapshot(std::istream& in) {
+  uint32_t version;
+  double velocity_state, pitch_state, wind_x, wind_y, wind_z;
+  if (!readSnapshotValue(in, version) || version != kVariablePitchSnapshotVersion) {
+    gzerr << "[gazebo_variable_pitch_motor_model] Unsupported snapshot of motor [" << motor_number_ << "].\n";
+    return false;
+  }
+  bool ok = readSnapshotValue(in, prev_sim_time_) && readSnapshotValue(in, sampling_time_) &&
+      readSnapshotValue(in, motor_rot_vel_) && readSnapshotValue(in, ref_motor_rot_vel_) &&
+      readSnapshotValue(in, velocity_state) && readSnapshotValue(in, ref_pitch_) &&
+      readSnapshotValue(in, pitch_) && readSnapshotValue(in, pitch_state) &&
+      readSnapshotValue(in, wind_x) && readSnapshotValue(in, wind_y) && readSnapshotValue(in, wind_z);
+  if (!ok) {
+    gzerr << "[gazebo_variable_pitch_motor_model] Truncated snapshot of motor [" << motor_number_ << "].\n";
+    return false;
+  }
+
+  rotor_velocity_filter_->setState(velocity_state);
+  pitch_filter_->setState(pitch_state);
+  wind_speed_W_.Set(wind_x, wind_y, wind_z);
+  return true;
+}
+
+void GazeboVariablePitchMotorModel::Publish() {
+  turning_velocity_msg_.data = joint_->GetVelocity(0);
+  motor_velocity_pub_.publish(turning_velocity_msg_);
+}
+
+void GazeboVariablePitchMotorModel::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf) {
+  model_ = _model;
+
+  namespace_.clear();
+
+  if (_sdf->HasElement("robotNamespace"))
+    namespace_ = _sdf->GetElement("robotNamespace")->Get<std::string>();
+  else
+    gzerr << "[gazebo_variable_pitch_motor_model] Please specify a robotNamespace.\n";
+  node_handle_ = new ros::NodeHandle(namespace_);
+
+  if (_sdf->HasElement("jointName"))
+    joint_name_ = _sdf->GetElement("jointName")->Get<std::string>();
+  else
+    gzerr << "[gazebo_variable_pitch_motor_model] Please specify a jointName, where the rotor is attached.\n";
+  // Get the pointer to the joint.
+  joint_ = model_->GetJoint(joint_name_);
+  if (joint_ == NULL)
+    gzthrow("[gazebo_variable_pitch_motor_model] Couldn't find specified joint \"" << joint_name_ << "\".");
+
+  if (_sdf->HasElement("linkName"))
+    link_name_ = _sdf->GetElement("linkName")->Get<std::string>();
+  else
+    gzerr << "[gazebo_variable_pitch_motor_model] Please specify a linkName of the rotor.\n";
+  link_ = model_->GetLink(link_name_);
+  if (link_ == NULL)
+    gzthrow("[gazebo_variable_pitch_motor_model] Couldn't find specified link \"" << link_name_ << "\".");
+  // The moments are applied to the parent link.
+  physics::Link_V parent_links = link_->GetParentJointsLinks();
+  if (parent_links.empty())
+    gzthrow("[gazebo_variable_pitch_motor_model] Link \"" << link_name_ << "\" has no parent link to apply the moments to.");
+  parent_link_ = parent_links.at(0);
+
+  if (_sdf->HasElement("motorNumber"))
+    motor_number_ = _sdf->GetElement("motorNumber")->Get<int>();
+  else
+    gzerr << "[gazebo_variable_pitch_motor_model] Please specify a motorNumber.\n";
+
+  if (_sdf->HasElement("turningDirection")) {
+    std::string turning_direction = _sdf->GetElement("turningDirection")->Get<std::string>();
+    if (turning_direction == "cw")
+      turning_direction_ = turning_direction::CW;
+    else if (turning_direction == "ccw")
+      turning_direction_ = turning_direction::CCW;
+    else
+      gzerr << "[gazebo_variable_pitch_motor_model] Please only use 'cw' or 'ccw' as turningDirection.\n";
+  }
+  else
+    gzerr << "[gazebo_variable_pitch_motor_model] Please specify a turning direction ('cw' or 'ccw').\n";
+
+  getSdfParam<std::string>(_sdf, "commandSubTopic", command_sub_topic_, command_sub_topic_);
+  getSdfParam<std::string>(_sdf, "windSpeedSubTopic", wind_speed_sub_topic_, wind_speed_sub_topic_);
+  getSdfParam<std::string>(_sdf, "motorSpeedPubTopic", motor_speed_pub_topic_, motor_speed_pub_topic_);
+
+  getSdfParam<double>(_sdf, "rotorDragCoefficient", rotor_drag_coefficient_, rotor_drag_coefficient_);
+  getSdfParam<double>(_sdf, "rollingMomentCoefficient", rolling_moment_coefficient_,
+                      rolling_moment_coefficient_);
+  getSdfParam<double>(_sdf, "maxRotVelocity", max_rot_velocity_, max_rot_velocity_);
+  getSdfParam<double>(_sdf, "timeConstantUp", time_constant_up_, time_constant_up_);
+  getSdfParam<double>(_sdf, "timeConstantDown", time_constant_down_, time_constant_down_);
+  getSdfParam<double>(_sdf, "rotorVelocitySlowdownSim", rotor_velocity_slowdown_sim_, 10);
+
+  getSdfParam<double>(_sdf, "pitchTimeConstant", pitch_time_constant_, pitch_time_constant_);
+  getSdfParam<double>(_sdf, "minPitch", min_pitch_, min_pitch_);
+  getSdfParam<double>(_sdf, "maxPitch", max_pitch_, max_pitch_);
+  getSdfParam<double>(_sdf, "defaultPitch", ref_pitch_, ref_pitch_);
+  ref_pitch_ = std::max(min_pitch_, std::min(ref_pitch_, max_pitch_));
+  pitch_ = ref_pitch_;
+
+  // Blade element/momentum table
+  RotorBladeParameters blade;
+  getSdfParam<int>(_sdf, "bladeCount", blade.blade_count, 2);
+  getSdfParam<double>(_sdf, "bladeRadius", blade.radius, 0.15);
+  getSdfParam<double>(_sdf, "bladeRootCutout", blade.root_cutout, 0.15);
+  getSdfParam<double>(_sdf, "bladeChord", blade.chord, 0.025);
+  getSdfParam<double>(_sdf, "bladeTwist", blade.twist, 0.0);
+  getSdfParam<double>(_sdf, "bladeLiftSlope", blade.lift_slope, 5.7);
+  getSdfParam<double>(_sdf, "bladeProfileDrag", blade.profile_drag, 0.01);
+  getSdfParam<double>(_sdf, "fluidDensity", blade.fluid_density, 1.225);
+  getSdfParam<int>(_sdf, "bladeElements", blade.elements, 30);
+
+  getSdfParam<std::string>(_sdf, "performanceTableFile", performance_table_file_, performance_table_file_);
+  getSdfParam<double>(_sdf, "maxInflowVelocity", max_inflow_velocity_, max_inflow_velocity_);
+  getSdfParam<int>(_sdf, "pitchTableSize", pitch_table_size_, pitch_table_size_);
+  getSdfParam<int>(_sdf, "omegaTableSize", omega_table_size_, omega_table_size_);
+  getSdfParam<int>(_sdf, "inflowTableSize", inflow_table_size_, inflow_table_size_);
+
+  {
+    std::lock_guard<std::mutex> lock(table_cache_mutex);
+    if (!performance_table_file_.empty())
+      performance_table_ = table_cache[performance_table_file_].lock();
+
+    if (!performance_table_) {
+      std::shared_ptr<RotorPerformanceTable> table(new RotorPerformanceTable());
+      if (performance_table_file_.empty() || !table->Load(performance_table_file_)) {
+        TableAxis pitch_axis = {min_pitch_, max_pitch_, pitch_table_size_};
+        TableAxis omega_axis = {0.0, max_rot_velocity_, omega_table_size_};
+        TableAxis inflow_axis = {-max_inflow_velocity_, max_inflow_velocity_, inflow_table_size_};
+        table->Generate(blade, pitch_axis, omega_axis, inflow_axis);
+        if (!performance_table_file_.empty() && !table->Save(performance_table_file_))
+          gzerr << "[gazebo_variable_pitch_motor_model] Couldn't write performance table to \""
+                << performance_table_file_ << "\".\n";
+      }
+      if (!performance_table_file_.empty())
+        table_cache[performance_table_file_] = table;
+      performance_table_ = table;
+    }
+  }
+
+  // Listen to the update event. This event is broadcast every
+  // simulation iteration.
+  updateConnection_ = event::Events::ConnectWorldUpdateBegin(
+      boost::bind(&GazeboVariablePitchMotorModel::OnUpdate, this, _1));
+
+  //Publishers and Subscribers
+  command_sub_ = node_handle_->subscribe(command_sub_topic_, 1, &GazeboVariablePitchMotorModel::VelocityCallback, this);
+  wind_speed_sub_ = node_handle_->subscribe(wind_speed_sub_topic_, 1,
+                                            &GazeboVariablePitchMotorModel::WindSpeedCallback, this);
+  motor_velocity_pub_ = node_handle_->advertise<std_msgs::Float32>(motor_speed_pub_topic_, 1);
+
+  // Create the first order filters.
+  rotor_velocity_filter_.reset(new FirstOrderFilter<double>(time_constant_up_, time_constant_down_, ref_motor_rot_vel_));
+  pitch_filter_.reset(new FirstOrderFilter<double>(pitch_time_constant_, pitch_time_constant_, ref_pitch_));
+
+  // Make the internal state available to the scenario snapshot world plugin.
+  snapshot_key_ = model_->GetScopedName() + "::" + joint_name_;
+  SnapshotRegistry::Instance().Register(snapshot_key_, this);
+}
+
+// This gets called by the world update start event.
+void GazeboVariablePitchMotorModel::OnUpdate(const common::UpdateInfo& _info) {
+  sampling_time_ = _info.simTime.Double() - prev_sim_time_;
+  prev_sim_time_ = _info.simTime.Double();
+  UpdateForcesAndMoments();
+  Publish();
+}
+
+void GazeboVariablePitchMotorModel::VelocityCallback(const mav_msgs::ActuatorsConstPtr& rot_velocities) {
+  ROS_ASSERT_MSG(rot_velocities->angular_velocities.size() > motor_number_,
+                 "You tried to access index %d of the MotorSpeed message array which is of size %d.",
+                 motor_number_, rot_velocities->angular_velocities.size());
+  ref_motor_rot_vel_ = std::min(rot_velocities->angular_velocities[motor_number_], max_rot_velocity_);
+  // Pitch is optional, a velocity only command keeps the last pitch reference (defaultPitch at first).
+  if (rot_velocities->angles.size() > motor_number_)
+    ref_pitch_ = std::max(min_pitch_, std::min(rot_velocities->angles[motor_number_], max_pitch_));
+}
+
+void GazeboVariablePitchMotorModel::WindSpeedCallback(const rotors_comm::WindSpeedConstPtr& wind_speed) {
+  wind_speed_W_.X(wind_speed->velocity.x);
+  wind_speed_W_.Y(wind_speed->velocity.y);
+  wind_speed_W_.Z(wind_speed->velocity.z);
+}
+
+void GazeboVariablePitchMotorModel::UpdateForcesAndMoments() {
+  motor_rot_vel_ = joint_->GetVelocity(0);
+  if (motor_rot_vel_ / (2 * M_PI) > 1 / (2 * sampling_time_)) {
+    gzerr << "Aliasing on motor [" << motor_number_ << "] might occur. Consider making smaller simulation time steps or raising the rotor_velocity_slowdown_sim_ param.\n";
+  }
+  double real_motor_velocity = motor_rot_vel_ * rotor_velocity_slowdown_sim_;
+
+  ignition::math::Vector3<double> joint_axis = joint_->GlobalAxis(0);
+  ignition::math::Vector3<double> body_velocity_W = link_->WorldLinearVel();
+  ignition::math::Vector3<double> relative_wind_velocity_W = body_velocity_W - wind_speed_W_;
+  double inflow_velocity = relative_wind_velocity_W.Dot(joint_axis);
+
+  double thrust, torque;
+  performance_table_->Lookup(pitch_, std::abs(real_motor_velocity), inflow_velocity, thrust, torque);
+  link_->AddRelativeForce(ignition::math::Vector3<double>(0, 0, thrust));
+
+  // Forces from Philppe Martin's and Erwan Salaün's
+  // 2010 IEEE Conference on Robotics and Automation paper
+  // The True Role of Accelerometer Feedback in Quadrotor Control
+  // - \omega * \lambda_1 * V_A^{\perp}
+  ignition::math::Vector3<double> body_velocity_perpendicular = relative_wind_velocity_W - (inflow_velocity * joint_axis);
+  ignition::math::Vector3<double> air_drag = -std::abs(real_motor_velocity) * rotor_drag_coefficient_ * body_velocity_perpendicular;
+  // Apply air_drag to link.
+  link_->AddForce(air_drag);
+  // Moments
+  // The tansformation from the parent_link to the link_.
+  ignition::math::Pose3<double> pose_difference = link_->WorldCoGPose() - parent_link_->WorldCoGPose();
+  ignition::math::Vector3<double> drag_torque(0, 0, -turning_direction_ * torque);
+  // Transforming the drag torque into the parent frame to handle arbitrary rotor orientations.
+  ignition::math::Vector3<double> drag_torque_parent_frame = pose_difference.Rot().RotateVector(drag_torque);
+  parent_link_->AddRelativeTorque(drag_torque_parent_frame);
+
+  ignition::math::Vector3<double> rolling_moment;
+  // - \omega * \mu_1 * V_A^{\perp}
+  rolling_moment = -std::abs(real_motor_velocity) * rolling_moment_coefficient_ * body_velocity_perpendicular;
+  parent_link_->AddTorque(rolling_moment);
+
+  // Apply the filters on the motor's velocity and the blade pitch.
+  pitch_ = pitch_filter_->updateFilter(ref_pitch_, sampling_time_);
+  double ref_motor_rot_vel;
+  ref_motor_rot_vel = rotor_velocity_filter_->updateFilter(ref_motor_rot_vel_, sampling_time_);
+  joint_->SetVelocity(0, turning_direction_ * ref_motor_rot_vel / rotor_velocity_slowdown_sim_);
+}
+
+GZ_REGISTER_MODEL_PLUGIN(GazeboVariablePitchMotorModel);
+}
@@ -0,0 +1,104 @@
+#include "mmuav_plugins/mass_properties_shm.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace gazebo {
+
+namespace {
+MassPropertiesShmLayout* Map(int fd, int protection) {
+  void* map = mmap(NULL, sizeof(MassPropertiesShmLayout), protection, MAP_SHARED, fd, 0);
+  return map == MAP_FAILED ? nullptr : static_cast<MassPropertiesShmLayout*>(map);
+}
+}
+
+std::unique_ptr<MassPropertiesShm> MassPropertiesShm::Create(const std::string& path) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return nullptr;
+
+  MassPropertiesShmLayout* layout = nullptr;
+  if (ftruncate(fd, sizeof(MassPropertiesShmLayout)) != 0 || !(layout = Map(fd, PROT_READ | PROT_WRITE))) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return nullptr;
+  }
+
+  memset(layout, 0, sizeof(MassPropertiesShmLayout));
+  layout->version = kMassPropertiesVersion;
+  layout->size = sizeof(MassPropertiesShmLayout);
+  // The magic goes in last, readers that see it see a complete header.
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(layout->magic, kMassPropertiesMagic, sizeof(layout->magic));
+  return std::unique_ptr<MassPropertiesShm>(new MassPropertiesShm(path, fd, layout));
+}
+
+std::unique_ptr<MassPropertiesShm> MassPropertiesShm::Open(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat status;
+  MassPropertiesShmLayout* layout = nullptr;
+  if (fstat(fd, &status) == 0) {
+    if (status.st_size >= static_cast<off_t>(sizeof(MassPropertiesShmLayout)))
+      layout = Map(fd, PROT_READ);
+    else
+      errno = EINVAL;
+  }
+  if (!layout) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return nullptr;
+  }
+
+  if (memcmp(layout->magic, kMassPropertiesMagic, sizeof(layout->magic)) != 0 ||
+      layout->version != kMassPropertiesVersion || layout->size != sizeof(MassPropertiesShmLayout)) {
+    munmap(layout, sizeof(MassPropertiesShmLayout));
+    close(fd);
+    errno = EINVAL;
+    return nullptr;
+  }
+  return std::unique_ptr<MassPropertiesShm>(new MassPropertiesShm(path, fd, layout));
+}
+
+MassPropertiesShm::MassPropertiesShm(const std::string& path, int fd, MassPropertiesShmLayout* layout)
+    : path_(path),
+      fd_(fd),
+      layout_(layout) {}
+
+MassPropertiesShm::~MassPropertiesShm() {
+  munmap(layout_, sizeof(MassPropertiesShmLayout));
+  close(fd_);
+}
+
+void MassPropertiesShm::Write(const MassProperties& properties) {
+  uint64_t sequence = __atomic_load_n(&layout_->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&layout_->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  layout_->properties = properties;
+  __atomic_store_n(&layout_->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+bool MassPropertiesShm::Read(MassProperties& properties) const {
+  for (;;) {
+    uint64_t sequence = __atomic_load_n(&layout_->sequence, __ATOMIC_ACQUIRE);
+    if (sequence == 0)
+      return false;
+    if (sequence & 1)
+      continue;
+    properties = layout_->properties;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&layout_->sequence, __ATOMIC_RELAXED) == sequence)
+      return true;
+  }
+}
+
+}
@@ -0,0 +1,163 @@
+#include "mmuav_plugins/rotor_performance_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace gazebo {
+
+static constexpr int kBladeElementMomentumIterations = 60;
+
+RotorPerformanceTable::RotorPerformanceTable() {
+  for (int i = 0; i < 3; i++) {
+    axes_[i].min = 0.0;
+    axes_[i].max = 0.0;
+    axes_[i].size = 0;
+    inverse_step_[i] = 0.0;
+  }
+}
+
+void RotorPerformanceTable::SolveBladeElementMomentum(const RotorBladeParameters& blade, double pitch, double omega,
+                                                      double inflow, double& thrust, double& torque) {
+  thrust = 0.0;
+  torque = 0.0;
+  omega = std::abs(omega);
+  if (omega <= 0.0 || blade.radius <= 0.0 || blade.elements <= 0)
+    return;
+
+  const double tip_speed = omega * blade.radius;
+  const double climb_ratio = inflow / tip_speed;
+  const double solidity = blade.blade_count * blade.chord / (M_PI * blade.radius);
+  const double dr = (1.0 - blade.root_cutout) / blade.elements;
+
+  double thrust_coefficient = 0.0;
+  double power_coefficient = 0.0;
+  for (int i = 0; i < blade.elements; i++) {
+    const double r = blade.root_cutout + (i + 0.5) * dr;
+    // Pitch is the collective at 75% of the radius, twist is linear along the blade.
+    const double theta = pitch + blade.twist * (r - 0.75);
+
+    // Blade element thrust must equal the momentum theory thrust of the annulus:
+    //   0.5*sigma*a*(theta*r^2 - lambda*r) = 4*F*|lambda|*(lambda - lambda_c)*r
+    // The left side falls and the right side rises with lambda, so the root is bracketed by bisection.
+    // F is Prandtl's tip loss factor and depends on lambda itself.
+    double low = std::min(climb_ratio, 0.0) - 2.0;
+    double high = std::max(climb_ratio, 0.0) + 2.0;
+    double lambda = 0.5 * (low + high);
+    for (int k = 0; k < kBladeElementMomentumIterations; k++) {
+      lambda = 0.5 * (low + high);
+      double f = 0.5 * blade.blade_count * (1.0 - r) / std::max(std::abs(lambda), 1e-6);
+      double tip_loss = 2.0 / M_PI * acos(exp(-f));
+      double residual = 0.5 * solidity * blade.lift_slope * (theta * r * r - lambda * r) -
+          4.0 * tip_loss * std::abs(lambda) * (lambda - climb_ratio) * r;
+      if (residual > 0.0)
+        low = lambda;
+      else
+        high = lambda;
+    }
+
+    double d_thrust = 0.5 * solidity * blade.lift_slope * (theta * r * r - lambda * r) * dr;
+    thrust_coefficient += d_thrust;
+    power_coefficient += lambda * d_thrust + 0.5 * solidity * blade.profile_drag * r * r * r * dr;
+  }
+
+  const double area = M_PI * blade.radius * blade.radius;
+  thrust = thrust_coefficient * blade.fluid_density * area * tip_speed * tip_speed;
+  torque = power_coefficient * blade.fluid_density * area * tip_speed * tip_speed * blade.radius;
+}
+
+void RotorPerformanceTable::Generate(const RotorBladeParameters& blade, const TableAxis& pitch,
+                                     const TableAxis& omega, const TableAxis& inflow) {
+  axes_[0] = pitch;
+  axes_[1] = omega;
+  axes_[2] = inflow;
+  for (int i = 0; i < 3; i++) {
+    axes_[i].size = std::max(axes_[i].size, 2);
+    inverse_step_[i] = axes_[i].max > axes_[i].min ? (axes_[i].size - 1) / (axes_[i].max - axes_[i].min) : 0.0;
+  }
+
+  size_t size = static_cast<size_t>(axes_[0].size) * axes_[1].size * axes_[2].size;
+  thrust_.assign(size, 0.0);
+  torque_.assign(size, 0.0);
+
+  for (int i = 0; i < axes_[0].size; i++) {
+    double p = axes_[0].min + i * (axes_[0].max - axes_[0].min) / (axes_[0].size - 1);
+    for (int j = 0; j < axes_[1].size; j++) {
+      double w = axes_[1].min + j * (axes_[1].max - axes_[1].min) / (axes_[1].size - 1);
+      for (int k = 0; k < axes_[2].size; k++) {
+        double v = axes_[2].min + k * (axes_[2].max - axes_[2].min) / (axes_[2].size - 1);
+        SolveBladeElementMomentum(blade, p, w, v, thrust_[Index(i, j, k)], torque_[Index(i, j, k)]);
+      }
+    }
+  }
+}
+
+bool RotorPerformanceTable::Load(const std::string& path) {
+  std::ifstream in(path.c_str());
+  if (!in)
+    return false;
+
+  TableAxis axes[3];
+  for (int i = 0; i < 3; i++) {
+    in >> axes[i].min >> axes[i].max >> axes[i].size;
+    if (!in || axes[i].size < 2)
+      return false;
+  }
+
+  size_t size = static_cast<size_t>(axes[0].size) * axes[1].size * axes[2].size;
+  std::vector<double> thrust(size), torque(size);
+  for (size_t i = 0; i < size; i++)
+    in >> thrust[i];
+  for (size_t i = 0; i < size; i++)
+    in >> torque[i];
+  if (!in)
+    return false;
+
+  for (int i = 0; i < 3; i++) {
+    axes_[i] = axes[i];
+    inverse_step_[i] = axes_[i].max > axes_[i].min ? (axes_[i].size - 1) / (axes_[i].max - axes_[i].min) : 0.0;
+  }
+  thrust_.swap(thrust);
+  torque_.swap(torque);
+  return true;
+}
+
+bool RotorPerformanceTable::Save(const std::string& path) const {
+  std::ofstream out(path.c_str());
+  if (!out)
+    return false;
+
+  out.precision(std::numeric_limits<double>::digits10 + 2);
+  for (int i = 0; i < 3; i++)
+    out << axes_[i].min << " " << axes_[i].max << " " << axes_[i].size << "\n";
+  for (size_t i = 0; i < thrust_.size(); i++)
+    out << thrust_[i] << ((i + 1) % axes_[2].size ? " " : "\n");
+  for (size_t i = 0; i < torque_.size(); i++)
+    out << torque_[i] << ((i + 1) % axes_[2].size ? " " : "\n");
+  return static_cast<bool>(out);
+}
+
+void RotorPerformanceTable::Lookup(double pitch, double omega, double inflow, double& thrust, double& torque) const {
+  const double query[3] = {pitch, omega, inflow};
+  int index[3];
+  double t[3];
+  for (int i = 0; i < 3; i++) {
+    double x = (query[i] - axes_[i].min) * inverse_step_[i];
+    x = std::max(0.0, std::min(x, static_cast<double>(axes_[i].size - 1)));
+    index[i] = std::min(static_cast<int>(x), axes_[i].size - 2);
+    t[i] = x - index[i];
+  }
+
+  thrust = 0.0;
+  torque = 0.0;
+  for (int corner = 0; corner < 8; corner++) {
+    int di = (corner >> 2) & 1, dj = (corner >> 1) & 1, dk = corner & 1;
+    double weight = (di ? t[0] : 1.0 - t[0]) * (dj ? t[1] : 1.0 - t[1]) * (dk ? t[2] : 1.0 - t[2]);
+    size_t n = Index(index[0] + di, index[1] + dj, index[2] + dk);
+    thrust += weight * thrust_[n];
+    torque += weight * torque_[n];
+  }
+}
+
+}
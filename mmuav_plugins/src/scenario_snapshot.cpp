@@ -0,0 +1,71 @@
+#include "mmuav_plugins/scenario_snapshot.h"
+
+#include <sstream>
+#include <stdint.h>
+
+namespace gazebo {
+
+void writeSnapshotString(std::ostream& out, const std::string& value) {
+  writeSnapshotValue<uint32_t>(out, value.size());
+  out.write(value.data(), value.size());
+}
+
+bool readSnapshotString(std::istream& in, std::string& value) {
+  uint32_t size;
+  if (!readSnapshotValue(in, size))
+    return false;
+  value.resize(size);
+  if (size > 0)
+    in.read(&value[0], size);
+  return static_cast<bool>(in);
+}
+
+SnapshotRegistry& SnapshotRegistry::Instance() {
+  static SnapshotRegistry registry;
+  return registry;
+}
+
+void SnapshotRegistry::Register(const std::string& key, SnapshotParticipant* participant) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  participants_[key] = participant;
+}
+
+void SnapshotRegistry::Unregister(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  participants_.erase(key);
+}
+
+void SnapshotRegistry::Save(std::ostream& out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  writeSnapshotValue<uint32_t>(out, participants_.size());
+  for (auto it = participants_.begin(); it != participants_.end(); ++it) {
+    // Each participant is stored as a sized blob, so entries without a match can be skipped on restore.
+    std::ostringstream blob;
+    it->second->SaveSnapshot(blob);
+    writeSnapshotString(out, it->first);
+    writeSnapshotString(out, blob.str());
+  }
+}
+
+int SnapshotRegistry::Restore(std::istream& in) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint32_t count;
+  if (!readSnapshotValue(in, count))
+    return -1;
+
+  int restored = 0;
+  std::string key, blob;
+  for (uint32_t i = 0; i < count; i++) {
+    if (!readSnapshotString(in, key) || !readSnapshotString(in, blob))
+      return -1;
+    auto it = participants_.find(key);
+    if (it == participants_.end())
+      continue;
+    std::istringstream blob_stream(blob);
+    if (it->second->RestoreSnapshot(blob_stream))
+      restored++;
+  }
+  return restored;
+}
+
+}
@@ -0,0 +1,208 @@
+#include "mmuav_plugins/serial_hil_link.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+bool BaudrateConstant(int baudrate, speed_t& speed) {
+  switch (baudrate) {
+    case 9600: speed = B9600; return true;
+    case 19200: speed = B19200; return true;
+    case 38400: speed = B38400; return true;
+    case 57600: speed = B57600; return true;
+    case 115200: speed = B115200; return true;
+    case 230400: speed = B230400; return true;
+    case 460800: speed = B460800; return true;
+    case 921600: speed = B921600; return true;
+  }
+  return false;
+}
+
+double MonotonicTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + 1e-9 * now.tv_nsec;
+}
+
+}
+
+void EncodeSerialFrame(const SerialFrame& frame, uint8_t* buffer) {
+  for (size_t i = 0; i < kSerialFrameValues; i++) {
+    uint32_t value = static_cast<uint32_t>(frame.values[i]);
+    buffer[4 * i] = value & 0xff;
+    buffer[4 * i + 1] = (value >> 8) & 0xff;
+    buffer[4 * i + 2] = (value >> 16) & 0xff;
+    buffer[4 * i + 3] = (value >> 24) & 0xff;
+  }
+  buffer[4 * kSerialFrameValues] = frame.terminator;
+  buffer[4 * kSerialFrameValues + 1] = 0;
+  buffer[4 * kSerialFrameValues + 2] = 0;
+  buffer[4 * kSerialFrameValues + 3] = 0;
+}
+
+SerialHilLink::SerialHilLink() : fd_(-1) {}
+
+SerialHilLink::~SerialHilLink() {
+  Close();
+}
+
+bool SerialHilLink::Open(const std::string& device, int baudrate) {
+  Close();
+  speed_t speed;
+  if (!BaudrateConstant(baudrate, speed)) {
+    error_ = "unsupported baudrate";
+    return false;
+  }
+
+  fd_ = open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd_ < 0) {
+    error_ = strerror(errno);
+    return false;
+  }
+
+  // Same line settings as the ROS bridge: 8N1, raw, no flow control.
+  struct termios tty;
+  memset(&tty, 0, sizeof tty);
+  if (tcgetattr(fd_, &tty) != 0) {
+    error_ = strerror(errno);
+    Close();
+    return false;
+  }
+  cfsetospeed(&tty, speed);
+  cfsetispeed(&tty, speed);
+  cfmakeraw(&tty);
+  tty.c_cflag &= ~(PARENB | CSTOPB | CSIZE | CRTSCTS);
+  tty.c_cflag |= CS8 | CREAD | CLOCAL;
+  tcflush(fd_, TCIFLUSH);
+  if (tcsetattr(fd_, TCSANOW, &tty) != 0) {
+    error_ = strerror(errno);
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool SerialHilLink::OpenPty() {
+  Close();
+  fd_ = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd_ < 0 || grantpt(fd_) != 0 || unlockpt(fd_) != 0) {
+    error_ = strerror(errno);
+    Close();
+    return false;
+  }
+  slave_name_ = ptsname(fd_);
+
+  struct termios tty;
+  if (tcgetattr(fd_, &tty) == 0) {
+    cfmakeraw(&tty);
+    tcsetattr(fd_, TCSANOW, &tty);
+  }
+  return true;
+}
+
+void SerialHilLink::Close() {
+  if (fd_ >= 0)
+    close(fd_);
+  fd_ = -1;
+  buffer_.clear();
+}
+
+bool SerialHilLink::Write(const SerialFrame& frame) {
+  if (fd_ < 0)
+    return false;
+  uint8_t data[kSerialFrameSize];
+  EncodeSerialFrame(frame, data);
+
+  // One write per frame, a partial write is finished right away so frames never interleave.
+  size_t written = 0;
+  while (written < kSerialFrameSize) {
+    ssize_t n = write(fd_, data + written, kSerialFrameSize - written);
+    if (n > 0) {
+      written += n;
+    } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+      error_ = strerror(errno);
+      return false;
+    } else if (n < 0 && errno == EAGAIN) {
+      fd_set set;
+      FD_ZERO(&set);
+      FD_SET(fd_, &set);
+      struct timeval timeout = {0, 10000};
+      if (select(fd_ + 1, NULL, &set, NULL, &timeout) <= 0) {
+        error_ = "write timeout";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool SerialHilLink::FillBuffer(double timeout) {
+  if (timeout > 0.0) {
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(fd_, &set);
+    struct timeval tv;
+    tv.tv_sec = static_cast<long>(timeout);
+    tv.tv_usec = static_cast<long>((timeout - tv.tv_sec) * 1e6);
+    if (select(fd_ + 1, &set, NULL, NULL, &tv) <= 0)
+      return false;
+  }
+
+  uint8_t data[256];
+  ssize_t n = read(fd_, data, sizeof data);
+  if (n <= 0)
+    return false;
+  buffer_.insert(buffer_.end(), data, data + n);
+  return true;
+}
+
+bool SerialHilLink::ExtractFrame(uint8_t terminator, SerialFrame& frame) {
+  const size_t t = 4 * kSerialFrameValues;
+  size_t start = 0;
+  bool found = false;
+  for (; start + kSerialFrameSize <= buffer_.size(); start++) {
+    const uint8_t* candidate = &buffer_[start];
+    if (candidate[t] == terminator && candidate[t + 1] == 0 && candidate[t + 2] == 0 && candidate[t + 3] == 0) {
+      for (size_t i = 0; i < kSerialFrameValues; i++) {
+        frame.values[i] = static_cast<int32_t>(candidate[4 * i] | (candidate[4 * i + 1] << 8) |
+                                               (candidate[4 * i + 2] << 16) |
+                                               (static_cast<uint32_t>(candidate[4 * i + 3]) << 24));
+      }
+      frame.terminator = terminator;
+      found = true;
+      break;
+    }
+  }
+
+  // Everything before the frame is garbage, everything up to its end is used.
+  size_t consumed = found ? start + kSerialFrameSize : start;
+  buffer_.erase(buffer_.begin(), buffer_.begin() + consumed);
+  return found;
+}
+
+bool SerialHilLink::Read(uint8_t terminator, double timeout, SerialFrame& frame) {
+  if (fd_ < 0)
+    return false;
+
+  // Drain what is already there, the newest complete frame wins.
+  bool found = false;
+  while (FillBuffer(0.0)) {}
+  while (ExtractFrame(terminator, frame))
+    found = true;
+  if (found || timeout <= 0.0)
+    return found;
+
+  double deadline = MonotonicTime() + timeout;
+  for (double left = timeout; left > 0.0; left = deadline - MonotonicTime()) {
+    if (FillBuffer(left) && ExtractFrame(terminator, frame))
+      return true;
+  }
+  return false;
+}